@@ -0,0 +1,31 @@
+#include "CmdArgs.h"
+#include "Print.h"
+
+using namespace elfgen;
+
+CmdArgs::CmdArgs() : m_Options("ElfGen", "Synthetic ELF generator") {
+    m_Options.add_options()
+        ("h,help", "Show help")
+        ("spec", "", cxxopts::value<std::string>())
+        ("o,out", "Output directory", cxxopts::value<std::string>()->default_value("."));
+
+    m_Options.parse_positional({ "spec" });
+}
+
+bool CmdArgs::parse(int argc, const char* const* argv) {
+    m_Spec.clear();
+    m_Output.clear();
+
+    auto result = m_Options.parse(argc, argv);
+
+    if (result.count("help")) {
+        elfgen::print("{}", m_Options.help());
+        return false;
+    }
+
+    if (result["spec"].count())
+        m_Spec = result["spec"].as<std::string>();
+
+    m_Output = result["out"].as<std::string>();
+    return true;
+}
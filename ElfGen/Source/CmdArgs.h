@@ -0,0 +1,26 @@
+#ifndef _ELFGEN_CMDARGS_H
+#define _ELFGEN_CMDARGS_H
+
+#include <cxxopts.hpp>
+
+#include <filesystem>
+
+namespace elfgen {
+
+class CmdArgs {
+    cxxopts::Options m_Options;
+    std::filesystem::path m_Spec;
+    std::filesystem::path m_Output;
+
+public:
+    CmdArgs();
+
+    bool parse(int argc, const char* const* argv);
+
+    const std::filesystem::path& spec() const { return m_Spec; }
+    const std::filesystem::path& output() const { return m_Output; }
+};
+
+} // namespace elfgen
+
+#endif /* _ELFGEN_CMDARGS_H */
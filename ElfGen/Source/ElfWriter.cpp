@@ -0,0 +1,538 @@
+#include "ElfWriter.h"
+#include "Print.h"
+
+#include <algorithm>
+#include <bit>
+#include <deque>
+#include <fstream>
+
+using namespace elfgen;
+
+constexpr static std::uint32_t PAGE_SIZE = 0x1000;
+constexpr static std::uint32_t BX_LR = 0xE12FFF1E;
+constexpr static std::uint32_t BLOOM_SHIFT = 5;
+constexpr static std::size_t NUM_SEGMENTS = 3;
+constexpr static std::size_t NUM_GOT_HEADER_ENTRIES = 3;
+constexpr static std::size_t PLT0_SIZE = 20;
+constexpr static std::size_t PLT_ENTRY_SIZE = 12;
+
+// Same as the linker, chains average at most two symbols.
+constexpr static std::uint32_t BUCKET_COUNTS[] = { 1, 3, 17, 37, 67, 97, 131, 197, 263, 521, 1031, 2053, 4099, 8209, 16411, 32771, 65537, 131101 };
+
+static Elf32_Addr alignUp(std::size_t v, std::uint32_t alignment) { return static_cast<Elf32_Addr>((v + alignment - 1) & ~static_cast<std::size_t>(alignment - 1)); }
+
+static Elf32_Rel makeRel(std::size_t offset, std::size_t symIndex, std::uint8_t type) {
+    return Elf32_Rel { static_cast<Elf32_Addr>(offset), static_cast<Elf32_Word>(ELF32_R_INFO(symIndex, type)) };
+}
+
+static std::uint32_t sysvHash(std::string_view name) {
+    std::uint32_t h = 0;
+
+    for (const auto c : name) {
+        h = (h << 4) + static_cast<std::uint8_t>(c);
+        const auto g = h & 0xF0000000;
+        if (g)
+            h ^= g >> 24;
+
+        h &= ~g;
+    }
+
+    return h;
+}
+
+static std::uint32_t gnuHash(std::string_view name) {
+    std::uint32_t h = 5381;
+
+    for (const auto c : name)
+        h = (h * 33) + static_cast<std::uint8_t>(c);
+
+    return h;
+}
+
+static std::size_t bucketCount(std::size_t numSyms) {
+    std::size_t count = BUCKET_COUNTS[0];
+
+    for (const auto b : BUCKET_COUNTS) {
+        if (b > (numSyms / 2))
+            break;
+
+        count = b;
+    }
+
+    return count;
+}
+
+static std::string functionName(std::string_view prefix, std::size_t index) { return fmt::format("{}_f{}", prefix, index); }
+static std::string objectName(std::string_view prefix, std::size_t index) { return fmt::format("{}_d{}", prefix, index); }
+
+std::vector<ObjectDesc> elfgen::makeObjectTree(const ObjectSpec& spec) {
+    std::vector<ObjectDesc> objects;
+    std::deque<std::pair<std::size_t, std::size_t>> queue; // Object index and level.
+
+    objects.push_back(ObjectDesc { .fileName = spec.name + ".so", .prefix = spec.name });
+    queue.push_back({ 0, 0 });
+
+    std::vector<std::vector<std::size_t>> children(1);
+    while (!queue.empty()) {
+        const auto [index, level] = queue.front();
+        queue.pop_front();
+
+        if (level >= spec.deps.depth)
+            continue;
+
+        for (auto i = 0u; i < spec.deps.fanout; ++i) {
+            const auto childIndex = objects.size();
+            const auto prefix = fmt::format("{}_{}", spec.name, childIndex);
+            objects.push_back(ObjectDesc { .fileName = prefix + ".so", .prefix = prefix });
+            objects[index].needed.push_back(objects.back().fileName);
+            children[index].push_back(childIndex);
+            children.emplace_back();
+            queue.push_back({ childIndex, level + 1 });
+        }
+    }
+
+    // Objects without dependencies import from the program.
+    for (auto i = 0u; i < objects.size(); ++i) {
+        const auto& deps = children[i];
+        for (auto j = 0u; j < spec.imports; ++j) {
+            if (deps.empty() || (!spec.functions && !spec.objects)) {
+                objects[i].imports.push_back(fmt::format("ext_{}", j));
+                continue;
+            }
+
+            const auto& depPrefix = objects[deps[j % deps.size()]].prefix;
+            const auto k = j / deps.size();
+            if (spec.functions) {
+                objects[i].imports.push_back(functionName(depPrefix, k % spec.functions));
+            } else {
+                objects[i].imports.push_back(objectName(depPrefix, k % spec.objects));
+            }
+        }
+    }
+
+    return objects;
+}
+
+std::size_t ElfWriter::addString(std::string_view s) {
+    const auto offset = m_StringTable.size();
+    m_StringTable.insert(m_StringTable.end(), s.begin(), s.end());
+    m_StringTable.push_back('\0');
+    return offset;
+}
+
+Elf32_Half ElfWriter::addSection(Section&& section) {
+    m_Sections.push_back(std::move(section));
+    return static_cast<Elf32_Half>(m_Sections.size() - 1);
+}
+
+void ElfWriter::makeSymbols() {
+    m_Symbols.push_back(Symbol { .type = STT_NOTYPE });
+
+    for (const auto& name : m_Desc.imports)
+        m_Symbols.push_back(Symbol { .name = name, .type = STT_NOTYPE });
+
+    for (auto i = 0u; i < m_Spec.functions; ++i)
+        m_Symbols.push_back(Symbol { .name = functionName(m_Desc.prefix, i), .offset = 4 * i, .size = 4, .type = STT_FUNC });
+
+    for (auto i = 0u; i < m_Spec.objects; ++i)
+        m_Symbols.push_back(Symbol { .name = objectName(m_Desc.prefix, i), .offset = 4 * i, .size = 4, .type = STT_OBJECT });
+
+    for (auto& sym : m_Symbols)
+        sym.gnuHash = gnuHash(sym.name);
+
+    const auto firstExport = m_Symbols.begin() + 1 + m_Desc.imports.size();
+    m_NumExports = m_Symbols.end() - firstExport;
+    m_NumSysvBuckets = bucketCount(m_Symbols.size());
+
+    // GNU hashed symbols must be grouped by bucket.
+    if (m_Spec.gnuHash) {
+        m_NumGnuBuckets = bucketCount(m_NumExports);
+        m_NumBloomWords = std::bit_ceil(std::max<std::size_t>(32, 2 * m_NumExports)) / 32;
+        std::stable_sort(firstExport, m_Symbols.end(), [this](const Symbol& a, const Symbol& b) {
+            return (a.gnuHash % m_NumGnuBuckets) < (b.gnuHash % m_NumGnuBuckets);
+        });
+    }
+
+    for (auto i = 0u; i < m_Symbols.size(); ++i) {
+        if (m_Symbols[i].type == STT_FUNC)
+            m_FunctionIndices.push_back(i);
+    }
+}
+
+void ElfWriter::putHash(Elf32_Addr addr) {
+    std::vector<Elf32_Word> buckets(m_NumSysvBuckets, STN_UNDEF);
+    std::vector<Elf32_Word> chains(m_Symbols.size(), STN_UNDEF);
+
+    for (auto i = 1u; i < m_Symbols.size(); ++i) {
+        auto& bucket = buckets[sysvHash(m_Symbols[i].name) % buckets.size()];
+        chains[i] = bucket;
+        bucket = i;
+    }
+
+    put<Elf32_Word>(addr, buckets.size());
+    put<Elf32_Word>(addr + 4, chains.size());
+    std::memcpy(&m_Image[addr + 8], buckets.data(), buckets.size() * sizeof(Elf32_Word));
+    std::memcpy(&m_Image[addr + 8 + (buckets.size() * sizeof(Elf32_Word))], chains.data(), chains.size() * sizeof(Elf32_Word));
+}
+
+void ElfWriter::putGnuHash(Elf32_Addr addr) {
+    const auto symOffset = m_Symbols.size() - m_NumExports;
+    std::vector<Elf32_Word> bloom(m_NumBloomWords, 0);
+    std::vector<Elf32_Word> buckets(m_NumGnuBuckets, STN_UNDEF);
+    std::vector<Elf32_Word> chains(m_NumExports, 0);
+
+    for (auto i = symOffset; i < m_Symbols.size(); ++i) {
+        const auto h = m_Symbols[i].gnuHash;
+        bloom[(h / 32) & (bloom.size() - 1)] |= (1u << (h % 32)) | (1u << ((h >> BLOOM_SHIFT) % 32));
+
+        auto& bucket = buckets[h % buckets.size()];
+        if (bucket == STN_UNDEF)
+            bucket = i;
+
+        // The last symbol in each bucket is marked.
+        const bool last = ((i + 1) == m_Symbols.size()) || ((m_Symbols[i + 1].gnuHash % buckets.size()) != (h % buckets.size()));
+        chains[i - symOffset] = last ? (h | 1) : (h & ~1u);
+    }
+
+    put<Elf32_Word>(addr, buckets.size());
+    put<Elf32_Word>(addr + 4, symOffset);
+    put<Elf32_Word>(addr + 8, bloom.size());
+    put<Elf32_Word>(addr + 12, BLOOM_SHIFT);
+
+    auto offset = addr + 16;
+    for (const auto& v : { std::cref(bloom), std::cref(buckets), std::cref(chains) }) {
+        std::memcpy(&m_Image[offset], v.get().data(), v.get().size() * sizeof(Elf32_Word));
+        offset += v.get().size() * sizeof(Elf32_Word);
+    }
+}
+
+void ElfWriter::putSymbols(Elf32_Addr addr, Elf32_Addr textAddr, Elf32_Addr dataAddr) {
+    for (auto i = 0u; i < m_Symbols.size(); ++i) {
+        const auto& sym = m_Symbols[i];
+
+        Elf32_Sym entry = {};
+        if (i) {
+            entry.st_name = addString(sym.name);
+            entry.st_size = sym.size;
+            entry.st_info = ELF32_ST_INFO(STB_GLOBAL, sym.type);
+
+            if (sym.type == STT_FUNC) {
+                entry.st_value = textAddr + sym.offset;
+                entry.st_shndx = m_TextIndex;
+            } else if (sym.type == STT_OBJECT) {
+                entry.st_value = dataAddr + sym.offset;
+                entry.st_shndx = m_DataIndex;
+            }
+        }
+
+        put(addr + (i * sizeof(Elf32_Sym)), entry);
+    }
+}
+
+// Standard ARM PLT, PLT0 enters the lazy binder with lr = &GOT[2] and ip = &GOT[n].
+void ElfWriter::putPlt(Elf32_Addr addr, Elf32_Addr gotAddr) {
+    put<std::uint32_t>(addr, 0xE52DE004);      // push {lr}
+    put<std::uint32_t>(addr + 4, 0xE59FE004);  // ldr lr, [pc, #4]
+    put<std::uint32_t>(addr + 8, 0xE08FE00E);  // add lr, pc, lr
+    put<std::uint32_t>(addr + 12, 0xE5BEF008); // ldr pc, [lr, #8]!
+    put<std::uint32_t>(addr + 16, gotAddr - (addr + 16));
+
+    for (auto i = 0u; i < m_Spec.relocs.jumpSlot; ++i) {
+        const auto entryAddr = addr + PLT0_SIZE + (i * PLT_ENTRY_SIZE);
+        const auto slotAddr = gotAddr + ((NUM_GOT_HEADER_ENTRIES + i) * 4);
+        const auto offset = slotAddr - (entryAddr + 8);
+        put<std::uint32_t>(entryAddr, 0xE28FC600 | ((offset >> 20) & 0xFF));    // add ip, pc, #0xNN00000
+        put<std::uint32_t>(entryAddr + 4, 0xE28CCA00 | ((offset >> 12) & 0xFF)); // add ip, ip, #0xNN000
+        put<std::uint32_t>(entryAddr + 8, 0xE5BCF000 | (offset & 0xFFF));        // ldr pc, [ip, #0xNNN]!
+    }
+}
+
+void ElfWriter::putSectionHeaders(std::size_t offset, std::size_t shStrTabOffset) {
+    std::size_t nameOffset = 0;
+
+    for (auto i = 0u; i < m_Sections.size(); ++i) {
+        const auto& section = m_Sections[i];
+        std::memcpy(&m_Image[shStrTabOffset + nameOffset], section.name.data(), section.name.size());
+
+        Elf32_Shdr header = {};
+        header.sh_name = nameOffset;
+        header.sh_type = section.type;
+        header.sh_flags = section.flags;
+        header.sh_addr = section.addr;
+        header.sh_offset = section.offset;
+        header.sh_size = section.size;
+        header.sh_link = section.link;
+        header.sh_info = section.info;
+        header.sh_addralign = section.align;
+        header.sh_entsize = section.entSize;
+        put(offset + (i * sizeof(Elf32_Shdr)), header);
+
+        nameOffset += section.name.size() + 1;
+    }
+}
+
+bool ElfWriter::writeToFile(const std::filesystem::path& path) {
+    const auto& relocs = m_Spec.relocs;
+    const auto numRelative = relocs.relative + m_Spec.initArray + m_Spec.finiArray;
+    const auto numDynRelocs = numRelative + relocs.abs32 + relocs.globDat;
+
+    makeSymbols();
+
+    // Names of symbols are added while writing them.
+    m_StringTable.clear();
+    addString("");
+    const auto soNameOffset = addString(m_Desc.fileName);
+
+    std::vector<std::size_t> neededOffsets;
+    for (const auto& needed : m_Desc.needed)
+        neededOffsets.push_back(addString(needed));
+
+    std::size_t stringTableSize = m_StringTable.size();
+    for (auto i = 1u; i < m_Symbols.size(); ++i)
+        stringTableSize += m_Symbols[i].name.size() + 1;
+
+    // Read-only segment: headers, tables, PLT and text.
+    Elf32_Addr addr = sizeof(Elf32_Ehdr) + (NUM_SEGMENTS * sizeof(Elf32_Phdr));
+    m_Sections.push_back(Section {});
+
+    const auto hashAddr = alignUp(addr, 4);
+    const auto hashSize = (2 + m_NumSysvBuckets + m_Symbols.size()) * sizeof(Elf32_Word);
+    addr = hashAddr + hashSize;
+
+    const auto gnuHashAddr = alignUp(addr, 4);
+    const auto gnuHashSize = m_Spec.gnuHash ? (4 + m_NumBloomWords + m_NumGnuBuckets + m_NumExports) * sizeof(Elf32_Word) : 0;
+    addr = gnuHashAddr + gnuHashSize;
+
+    const auto symTabAddr = alignUp(addr, 4);
+    const auto symTabSize = m_Symbols.size() * sizeof(Elf32_Sym);
+    const Elf32_Addr strTabAddr = symTabAddr + symTabSize;
+
+    const auto relDynAddr = alignUp(strTabAddr + stringTableSize, 4);
+    const auto relDynSize = numDynRelocs * sizeof(Elf32_Rel);
+    const Elf32_Addr relPltAddr = relDynAddr + relDynSize;
+    const auto relPltSize = relocs.jumpSlot * sizeof(Elf32_Rel);
+
+    const auto pltAddr = alignUp(relPltAddr + relPltSize, 4);
+    const auto pltSize = relocs.jumpSlot ? (PLT0_SIZE + (relocs.jumpSlot * PLT_ENTRY_SIZE)) : 0;
+
+    const auto textAddr = alignUp(pltAddr + pltSize, 16);
+    const auto hasArrays = m_Spec.initArray || m_Spec.finiArray;
+    const auto textSize = alignUp(std::max<std::size_t>({ m_Spec.textSize, 4 * m_Spec.functions, hasArrays ? 4u : 0u }), 4);
+    const Elf32_Addr roEnd = textAddr + textSize;
+
+    // Writable segment: dynamic section, GOT, data and bss; file offsets match addresses.
+    std::vector<Elf32_Dyn> dynEntries;
+    for (const auto offset : neededOffsets)
+        dynEntries.push_back({ DT_NEEDED, { static_cast<Elf32_Word>(offset) } });
+
+    dynEntries.push_back({ DT_SONAME, { static_cast<Elf32_Word>(soNameOffset) } });
+    dynEntries.push_back({ DT_HASH, { hashAddr } });
+
+    if (m_Spec.gnuHash)
+        dynEntries.push_back({ DT_GNU_HASH, { gnuHashAddr } });
+
+    dynEntries.push_back({ DT_STRTAB, { strTabAddr } });
+    dynEntries.push_back({ DT_SYMTAB, { symTabAddr } });
+    dynEntries.push_back({ DT_STRSZ, { static_cast<Elf32_Word>(stringTableSize) } });
+    dynEntries.push_back({ DT_SYMENT, { sizeof(Elf32_Sym) } });
+
+    if (numDynRelocs) {
+        dynEntries.push_back({ DT_REL, { relDynAddr } });
+        dynEntries.push_back({ DT_RELSZ, { static_cast<Elf32_Word>(relDynSize) } });
+        dynEntries.push_back({ DT_RELENT, { sizeof(Elf32_Rel) } });
+        if (numRelative)
+            dynEntries.push_back({ DT_RELCOUNT, { static_cast<Elf32_Word>(numRelative) } });
+    }
+
+    // PLTGOT, jump slot entries, init and fini arrays and the terminator follow.
+    const auto dynamicAddr = alignUp(roEnd, PAGE_SIZE);
+    const auto numTrailingEntries = (relocs.jumpSlot ? 5 : 2) + (m_Spec.initArray ? 2 : 0) + (m_Spec.finiArray ? 2 : 0);
+    const auto dynamicSize = (dynEntries.size() + numTrailingEntries) * sizeof(Elf32_Dyn);
+
+    const auto gotAddr = static_cast<Elf32_Addr>(dynamicAddr + dynamicSize);
+    const auto gotSize = (NUM_GOT_HEADER_ENTRIES + relocs.jumpSlot + relocs.globDat) * 4;
+    dynEntries.push_back({ DT_PLTGOT, { gotAddr } });
+
+    const auto initArrayAddr = alignUp(gotAddr + gotSize, 4);
+    const auto initArraySize = m_Spec.initArray * sizeof(Elf32_Addr);
+    const auto finiArrayAddr = static_cast<Elf32_Addr>(initArrayAddr + initArraySize);
+    const auto finiArraySize = m_Spec.finiArray * sizeof(Elf32_Addr);
+
+    if (m_Spec.initArray) {
+        dynEntries.push_back({ DT_INIT_ARRAY, { initArrayAddr } });
+        dynEntries.push_back({ DT_INIT_ARRAYSZ, { static_cast<Elf32_Word>(initArraySize) } });
+    }
+
+    if (m_Spec.finiArray) {
+        dynEntries.push_back({ DT_FINI_ARRAY, { finiArrayAddr } });
+        dynEntries.push_back({ DT_FINI_ARRAYSZ, { static_cast<Elf32_Word>(finiArraySize) } });
+    }
+
+    if (relocs.jumpSlot) {
+        dynEntries.push_back({ DT_JMPREL, { relPltAddr } });
+        dynEntries.push_back({ DT_PLTRELSZ, { static_cast<Elf32_Word>(relPltSize) } });
+        dynEntries.push_back({ DT_PLTREL, { DT_REL } });
+    }
+
+    dynEntries.push_back({ DT_NULL, { 0 } });
+
+    const auto dataAddr = alignUp(finiArrayAddr + finiArraySize, 4);
+    const auto dataSize = alignUp(std::max<std::size_t>(m_Spec.dataSize, 4 * (m_Spec.objects + relocs.relative + relocs.abs32)), 4);
+    const Elf32_Addr fileEnd = dataAddr + dataSize;
+
+    // Sections, in address order.
+    const auto dynSymIndex = static_cast<Elf32_Word>(m_Spec.gnuHash ? 3 : 2);
+    const auto dynStrIndex = dynSymIndex + 1;
+
+    addSection(Section { ".hash", SHT_HASH, SHF_ALLOC, hashAddr, hashAddr, static_cast<Elf32_Word>(hashSize), dynSymIndex, 0, 4, 4 });
+
+    if (m_Spec.gnuHash)
+        addSection(Section { ".gnu.hash", SHT_GNU_HASH, SHF_ALLOC, gnuHashAddr, gnuHashAddr, static_cast<Elf32_Word>(gnuHashSize), dynSymIndex, 0, 4, 0 });
+
+    addSection(Section { ".dynsym", SHT_DYNSYM, SHF_ALLOC, symTabAddr, symTabAddr, static_cast<Elf32_Word>(symTabSize), dynStrIndex, 1, 4, sizeof(Elf32_Sym) });
+    addSection(Section { ".dynstr", SHT_STRTAB, SHF_ALLOC, strTabAddr, strTabAddr, static_cast<Elf32_Word>(stringTableSize), 0, 0, 1, 0 });
+
+    if (relDynSize)
+        addSection(Section { ".rel.dyn", SHT_REL, SHF_ALLOC, relDynAddr, relDynAddr, static_cast<Elf32_Word>(relDynSize), dynSymIndex, 0, 4, sizeof(Elf32_Rel) });
+
+    if (relPltSize) {
+        const auto pltIndex = static_cast<Elf32_Word>(m_Sections.size() + 1);
+        addSection(Section { ".rel.plt", SHT_REL, SHF_ALLOC | SHF_INFO_LINK, relPltAddr, relPltAddr, static_cast<Elf32_Word>(relPltSize), dynSymIndex, pltIndex, 4, sizeof(Elf32_Rel) });
+        addSection(Section { ".plt", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, pltAddr, pltAddr, static_cast<Elf32_Word>(pltSize), 0, 0, 4, 0 });
+    }
+
+    m_TextIndex = addSection(Section { ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, textAddr, textAddr, static_cast<Elf32_Word>(textSize), 0, 0, 16, 0 });
+    addSection(Section { ".dynamic", SHT_DYNAMIC, SHF_ALLOC | SHF_WRITE, dynamicAddr, dynamicAddr, static_cast<Elf32_Word>(dynamicSize), dynStrIndex, 0, 4, sizeof(Elf32_Dyn) });
+    addSection(Section { ".got", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, gotAddr, gotAddr, static_cast<Elf32_Word>(gotSize), 0, 0, 4, 4 });
+
+    if (initArraySize)
+        addSection(Section { ".init_array", SHT_INIT_ARRAY, SHF_ALLOC | SHF_WRITE, initArrayAddr, initArrayAddr, static_cast<Elf32_Word>(initArraySize), 0, 0, 4, 4 });
+
+    if (finiArraySize)
+        addSection(Section { ".fini_array", SHT_FINI_ARRAY, SHF_ALLOC | SHF_WRITE, finiArrayAddr, finiArrayAddr, static_cast<Elf32_Word>(finiArraySize), 0, 0, 4, 4 });
+
+    m_DataIndex = addSection(Section { ".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, dataAddr, dataAddr, static_cast<Elf32_Word>(dataSize), 0, 0, 4, 0 });
+
+    if (m_Spec.bssSize)
+        addSection(Section { ".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, fileEnd, fileEnd, static_cast<Elf32_Word>(m_Spec.bssSize), 0, 0, 4, 0 });
+
+    std::size_t shStrTabSize = 0;
+    const auto shStrTabIndex = addSection(Section { ".shstrtab", SHT_STRTAB, 0, 0, fileEnd, 0, 0, 0, 1, 0 });
+    for (const auto& section : m_Sections)
+        shStrTabSize += section.name.size() + 1;
+
+    m_Sections[shStrTabIndex].size = shStrTabSize;
+
+    const auto shOffset = alignUp(fileEnd + shStrTabSize, 4);
+    m_Image.assign(shOffset + (m_Sections.size() * sizeof(Elf32_Shdr)), 0);
+
+    // Header.
+    Elf32_Ehdr header = {};
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS32;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_NONE;
+    header.e_type = ET_DYN;
+    header.e_machine = EM_ARM;
+    header.e_version = EV_CURRENT;
+    header.e_phoff = sizeof(Elf32_Ehdr);
+    header.e_shoff = shOffset;
+    header.e_flags = EF_ARM_EABI_VER5 | EF_ARM_ABI_FLOAT_HARD;
+    header.e_ehsize = sizeof(Elf32_Ehdr);
+    header.e_phentsize = sizeof(Elf32_Phdr);
+    header.e_phnum = NUM_SEGMENTS;
+    header.e_shentsize = sizeof(Elf32_Shdr);
+    header.e_shnum = m_Sections.size();
+    header.e_shstrndx = shStrTabIndex;
+    put(0, header);
+
+    // Segments.
+    const Elf32_Phdr segments[NUM_SEGMENTS] = {
+        { PT_LOAD, 0, 0, 0, roEnd, roEnd, PF_R | PF_X, PAGE_SIZE },
+        { PT_LOAD, dynamicAddr, dynamicAddr, dynamicAddr, fileEnd - dynamicAddr, static_cast<Elf32_Word>(fileEnd - dynamicAddr + m_Spec.bssSize), PF_R | PF_W, PAGE_SIZE },
+        { PT_DYNAMIC, dynamicAddr, dynamicAddr, dynamicAddr, static_cast<Elf32_Word>(dynamicSize), static_cast<Elf32_Word>(dynamicSize), PF_R | PF_W, 4 },
+    };
+
+    for (auto i = 0u; i < NUM_SEGMENTS; ++i)
+        put(sizeof(Elf32_Ehdr) + (i * sizeof(Elf32_Phdr)), segments[i]);
+
+    // Symbol tables.
+    putHash(hashAddr);
+
+    if (m_Spec.gnuHash)
+        putGnuHash(gnuHashAddr);
+
+    putSymbols(symTabAddr, textAddr, dataAddr);
+    std::memcpy(&m_Image[strTabAddr], m_StringTable.data(), m_StringTable.size());
+
+    // Relocations, relative ones first as counted by DT_RELCOUNT.
+    const auto numSyms = m_Symbols.size() - 1;
+    const auto relocWordsAddr = dataAddr + (4 * m_Spec.objects);
+    auto relAddr = relDynAddr;
+
+    for (auto i = 0u; i < relocs.relative; ++i) {
+        const auto offset = relocWordsAddr + (4 * i);
+        const auto target = m_Spec.functions ? (textAddr + (4 * (i % m_Spec.functions))) : dataAddr;
+        put<Elf32_Word>(offset, static_cast<Elf32_Word>(target));
+        put(relAddr, makeRel(offset, 0, R_ARM_RELATIVE));
+        relAddr += sizeof(Elf32_Rel);
+    }
+
+    // Init and fini arrays are contiguous, every entry calls the first function.
+    for (auto i = 0u; i < (m_Spec.initArray + m_Spec.finiArray); ++i) {
+        const auto offset = initArrayAddr + (4 * i);
+        put<Elf32_Word>(offset, textAddr);
+        put(relAddr, makeRel(offset, 0, R_ARM_RELATIVE));
+        relAddr += sizeof(Elf32_Rel);
+    }
+
+    for (auto i = 0u; i < relocs.abs32; ++i) {
+        const auto offset = relocWordsAddr + (4 * (relocs.relative + i));
+        put(relAddr, makeRel(offset, 1 + (i % numSyms), R_ARM_ABS32));
+        relAddr += sizeof(Elf32_Rel);
+    }
+
+    for (auto i = 0u; i < relocs.globDat; ++i) {
+        const auto offset = gotAddr + ((NUM_GOT_HEADER_ENTRIES + relocs.jumpSlot + i) * 4);
+        put(relAddr, makeRel(offset, 1 + ((relocs.abs32 + i) % numSyms), R_ARM_GLOB_DAT));
+        relAddr += sizeof(Elf32_Rel);
+    }
+
+    // Calls go to imports first, then to exported functions.
+    for (auto i = 0u; i < relocs.jumpSlot; ++i) {
+        const auto offset = gotAddr + ((NUM_GOT_HEADER_ENTRIES + i) * 4);
+        const auto symIndex = m_Desc.imports.empty() ? m_FunctionIndices[i % m_FunctionIndices.size()] : (1 + (i % m_Desc.imports.size()));
+        put<Elf32_Word>(offset, pltAddr);
+        put(relPltAddr + (i * sizeof(Elf32_Rel)), makeRel(offset, symIndex, R_ARM_JUMP_SLOT));
+    }
+
+    if (relocs.jumpSlot)
+        putPlt(pltAddr, gotAddr);
+
+    // Code and data.
+    for (auto offset = textAddr; offset < roEnd; offset += 4)
+        put<std::uint32_t>(offset, BX_LR);
+
+    put<Elf32_Word>(gotAddr, dynamicAddr);
+
+    for (auto i = 0u; i < m_Spec.objects; ++i)
+        put<Elf32_Word>(dataAddr + (4 * i), i);
+
+    for (auto i = 0u; i < dynEntries.size(); ++i)
+        put(dynamicAddr + (i * sizeof(Elf32_Dyn)), dynEntries[i]);
+
+    putSectionHeaders(shOffset, fileEnd);
+
+    // Write file.
+    std::ofstream f(path, std::ios::binary);
+    if (!f.is_open() || !f.write(reinterpret_cast<const char*>(m_Image.data()), m_Image.size())) {
+        elfgen::printError(PrintFileInfo {
+            .fileName = path.string(),
+            .boldText = true,
+        }, "could not write file");
+        return false;
+    }
+
+    return true;
+}
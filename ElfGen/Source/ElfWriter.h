@@ -0,0 +1,82 @@
+#ifndef _ELFGEN_ELFWRITER_H
+#define _ELFGEN_ELFWRITER_H
+
+#include "Spec.h"
+
+#include <elf.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace elfgen {
+
+struct ObjectDesc {
+    std::string fileName;             // Output file name, also used as DT_SONAME.
+    std::string prefix;               // Prefix of exported symbol names.
+    std::vector<std::string> needed;  // DT_NEEDED entries.
+    std::vector<std::string> imports; // Undefined symbols.
+};
+
+// Objects are numbered breadth first, starting from the root; imports cycle through the exports of dependencies.
+std::vector<ObjectDesc> makeObjectTree(const ObjectSpec& spec);
+
+class ElfWriter {
+    struct Section {
+        std::string name;
+        Elf32_Word type;
+        Elf32_Word flags;
+        Elf32_Addr addr;
+        Elf32_Off offset;
+        Elf32_Word size;
+        Elf32_Word link;
+        Elf32_Word info;
+        Elf32_Word align;
+        Elf32_Word entSize;
+    };
+
+    struct Symbol {
+        std::string name;
+        Elf32_Word offset = 0;      // Offset in the text or data section.
+        Elf32_Word size = 0;
+        std::uint8_t type = 0;      // Functions are in text, objects in data, anything else is undefined.
+        std::uint32_t gnuHash = 0;
+    };
+
+    const ObjectSpec& m_Spec;
+    const ObjectDesc& m_Desc;
+    std::vector<std::uint8_t> m_Image;
+    std::vector<Section> m_Sections;
+    std::vector<Symbol> m_Symbols;
+    std::vector<std::uint8_t> m_StringTable;
+    std::vector<Elf32_Word> m_FunctionIndices; // Symbol indices of exported functions.
+    std::size_t m_NumExports = 0;
+    std::size_t m_NumSysvBuckets = 0;
+    std::size_t m_NumGnuBuckets = 0;
+    std::size_t m_NumBloomWords = 0;
+    Elf32_Half m_TextIndex = 0;
+    Elf32_Half m_DataIndex = 0;
+
+    std::size_t addString(std::string_view s);
+    Elf32_Half addSection(Section&& section);
+    void makeSymbols();
+
+    template <typename T>
+    void put(std::size_t offset, const T& value) { std::memcpy(m_Image.data() + offset, &value, sizeof(T)); }
+
+    void putHash(Elf32_Addr addr);
+    void putGnuHash(Elf32_Addr addr);
+    void putSymbols(Elf32_Addr addr, Elf32_Addr textAddr, Elf32_Addr dataAddr);
+    void putPlt(Elf32_Addr addr, Elf32_Addr gotAddr);
+    void putSectionHeaders(std::size_t offset, std::size_t shStrTabOffset);
+
+public:
+    ElfWriter(const ObjectSpec& spec, const ObjectDesc& desc) : m_Spec(spec), m_Desc(desc) {}
+    bool writeToFile(const std::filesystem::path& path);
+};
+
+} // namespace elfgen
+
+#endif /* _ELFGEN_ELFWRITER_H */
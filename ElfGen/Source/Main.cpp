@@ -0,0 +1,47 @@
+#include "CmdArgs.h"
+#include "ElfWriter.h"
+#include "Spec.h"
+#include "Print.h"
+
+using namespace elfgen;
+
+int main(int argc, const char* const* argv) {
+    // Parse arguments.
+    CmdArgs args;
+
+    try {
+        if (!args.parse(argc, argv))
+            return 0;
+    } catch (const cxxopts::exceptions::exception& ex) {
+        elfgen::printError({}, "{}", ex.what());
+        return 1;
+    }
+
+    if (args.spec().empty()) {
+        elfgen::printError({}, "no spec file");
+        return 1;
+    }
+
+    // Parse spec.
+    ObjectSpec spec;
+    if (!elfgen::parseSpecFile(args.spec(), spec))
+        return 1;
+
+    std::error_code ec;
+    std::filesystem::create_directories(args.output(), ec);
+    if (ec) {
+        elfgen::printError(PrintFileInfo {
+            .fileName = args.output().string(),
+            .boldText = true,
+        }, "could not create directory");
+        return 1;
+    }
+
+    // Generate objects, the root one is written first.
+    for (const auto& desc : elfgen::makeObjectTree(spec)) {
+        if (!ElfWriter(spec, desc).writeToFile(args.output() / desc.fileName))
+            return 1;
+    }
+
+    return 0;
+}
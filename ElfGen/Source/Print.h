@@ -0,0 +1,39 @@
+#ifndef _ELFGEN_PRINT_H
+#define _ELFGEN_PRINT_H
+
+#include <fmt/color.h>
+
+#include <string_view>
+#include <optional>
+
+namespace elfgen {
+
+struct PrintFileInfo {
+    std::string_view fileName;
+    bool boldText = false;
+};
+
+template <typename ... Args>
+void print(std::string_view fmt, Args&&... args) {
+    fmt::print(fmt::runtime(fmt), std::forward<Args>(args)...);
+    fmt::print("\n");
+}
+
+template <typename ... Args>
+void printError(std::optional<PrintFileInfo> fileInfo, std::string_view fmt, Args&&... args) {
+    if (fileInfo) {
+        if (fileInfo->boldText) {
+            fmt::print(fmt::emphasis::bold, "{}: ", fileInfo->fileName);
+        } else {
+            fmt::print("{}: ", fileInfo->fileName);
+        }
+    }
+
+    fmt::print(fmt::fg(fmt::color::crimson) | fmt::emphasis::bold, "error: ");
+    fmt::print(fmt::emphasis::bold, "{}", fmt::format(fmt::runtime(fmt), std::forward<Args>(args)...));
+    fmt::print("\n");
+}
+
+} // namespace elfgen
+
+#endif /* _ELFGEN_PRINT_H */
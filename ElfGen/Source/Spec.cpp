@@ -0,0 +1,162 @@
+#include <nlohmann/json.hpp>
+
+#include "Spec.h"
+#include "Print.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace elfgen;
+
+constexpr static std::size_t MAX_OBJECTS = 4096;
+constexpr static std::size_t MAX_COUNT = 1 << 24;
+
+static bool readSize(std::string_view fileName, const nlohmann::json& parent, const char* key, std::size_t& out) {
+    if (!parent.contains(key))
+        return true;
+
+    const auto& value = parent[key];
+    if (!value.is_number_unsigned() || (value.get<std::size_t>() > MAX_COUNT)) {
+        elfgen::printError(PrintFileInfo {
+            .fileName = fileName,
+            .boldText = true,
+        }, "expected unsigned integer up to {} for \"{}\"", MAX_COUNT, key);
+        return false;
+    }
+
+    out = value.get<std::size_t>();
+    return true;
+}
+
+static bool readBool(std::string_view fileName, const nlohmann::json& parent, const char* key, bool& out) {
+    if (!parent.contains(key))
+        return true;
+
+    if (!parent[key].is_boolean()) {
+        elfgen::printError(PrintFileInfo {
+            .fileName = fileName,
+            .boldText = true,
+        }, "expected bool for \"{}\"", key);
+        return false;
+    }
+
+    out = parent[key].get<bool>();
+    return true;
+}
+
+static bool readObject(std::string_view fileName, const nlohmann::json& parent, const char* key, nlohmann::json& out) {
+    if (!parent.contains(key)) {
+        out = nlohmann::json::object();
+        return true;
+    }
+
+    if (!parent[key].is_object()) {
+        elfgen::printError(PrintFileInfo {
+            .fileName = fileName,
+            .boldText = true,
+        }, "expected object for \"{}\"", key);
+        return false;
+    }
+
+    out = parent[key];
+    return true;
+}
+
+static bool parseSpec(std::string_view fileName, std::string_view content, ObjectSpec& out) {
+    // Parse json.
+    const auto jsonData = nlohmann::json::parse(content, nullptr, false, true);
+    if (!jsonData.is_object()) {
+        elfgen::printError(PrintFileInfo {
+            .fileName = fileName,
+            .boldText = true,
+        }, "expected object");
+        return false;
+    }
+
+    if (jsonData.contains("name")) {
+        if (!jsonData["name"].is_string() || jsonData["name"].get<std::string>().empty()) {
+            elfgen::printError(PrintFileInfo {
+                .fileName = fileName,
+                .boldText = true,
+            }, "expected non empty string for \"name\"");
+            return false;
+        }
+
+        out.name = jsonData["name"].get<std::string>();
+    }
+
+    nlohmann::json relocs;
+    nlohmann::json deps;
+
+    if (!readSize(fileName, jsonData, "functions", out.functions) ||
+        !readSize(fileName, jsonData, "objects", out.objects) ||
+        !readSize(fileName, jsonData, "imports", out.imports) ||
+        !readSize(fileName, jsonData, "text_size", out.textSize) ||
+        !readSize(fileName, jsonData, "data_size", out.dataSize) ||
+        !readSize(fileName, jsonData, "bss_size", out.bssSize) ||
+        !readSize(fileName, jsonData, "init_array", out.initArray) ||
+        !readSize(fileName, jsonData, "fini_array", out.finiArray) ||
+        !readBool(fileName, jsonData, "gnu_hash", out.gnuHash) ||
+        !readObject(fileName, jsonData, "relocs", relocs) ||
+        !readObject(fileName, jsonData, "deps", deps))
+        return false;
+
+    if (!readSize(fileName, relocs, "relative", out.relocs.relative) ||
+        !readSize(fileName, relocs, "abs32", out.relocs.abs32) ||
+        !readSize(fileName, relocs, "glob_dat", out.relocs.globDat) ||
+        !readSize(fileName, relocs, "jump_slot", out.relocs.jumpSlot) ||
+        !readSize(fileName, deps, "fanout", out.deps.fanout) ||
+        !readSize(fileName, deps, "depth", out.deps.depth))
+        return false;
+
+    // Validate the spec as a whole.
+    const auto numSyms = out.functions + out.objects + out.imports;
+    if ((out.relocs.abs32 || out.relocs.globDat) && !numSyms) {
+        elfgen::printError(PrintFileInfo {
+            .fileName = fileName,
+            .boldText = true,
+        }, "symbol relocations need at least one symbol");
+        return false;
+    }
+
+    if (out.relocs.jumpSlot && !out.functions && !out.imports) {
+        elfgen::printError(PrintFileInfo {
+            .fileName = fileName,
+            .boldText = true,
+        }, "jump slots need at least one function or import");
+        return false;
+    }
+
+    std::size_t numObjects = 1;
+    std::size_t levelSize = 1;
+    for (auto i = 0u; (i < out.deps.depth) && out.deps.fanout; ++i) {
+        levelSize *= out.deps.fanout;
+        numObjects += levelSize;
+        if (numObjects > MAX_OBJECTS) {
+            elfgen::printError(PrintFileInfo {
+                .fileName = fileName,
+                .boldText = true,
+            }, "dependency tree has more than {} objects", MAX_OBJECTS);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool elfgen::parseSpecFile(const std::filesystem::path& path, ObjectSpec& out) {
+    const auto fileName = path.string();
+
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        elfgen::printError(PrintFileInfo {
+            .fileName = fileName,
+            .boldText = true,
+        }, "could not open file");
+        return false;
+    }
+
+    std::stringstream content;
+    content << f.rdbuf();
+    return parseSpec(fileName, content.str(), out);
+}
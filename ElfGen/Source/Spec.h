@@ -0,0 +1,42 @@
+#ifndef _ELFGEN_SPEC_H
+#define _ELFGEN_SPEC_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace elfgen {
+
+struct RelocSpec {
+    std::size_t relative = 0; // R_ARM_RELATIVE, data words pointing to functions.
+    std::size_t abs32 = 0;    // R_ARM_ABS32, data words pointing to symbols.
+    std::size_t globDat = 0;  // R_ARM_GLOB_DAT, GOT entries.
+    std::size_t jumpSlot = 0; // R_ARM_JUMP_SLOT, PLT entries.
+};
+
+struct DepSpec {
+    std::size_t fanout = 0; // Dependencies of each object.
+    std::size_t depth = 0;  // Levels of dependencies below the root.
+};
+
+// Every object in the tree is generated from the same spec.
+struct ObjectSpec {
+    std::string name = "libgen";
+    std::size_t functions = 16; // Exported functions.
+    std::size_t objects = 0;    // Exported data objects.
+    std::size_t imports = 0;    // Undefined symbols, taken from dependencies when there are any.
+    RelocSpec relocs;
+    std::size_t textSize = 0;   // Minimum size of the text section.
+    std::size_t dataSize = 0;   // Minimum size of the data section.
+    std::size_t bssSize = 0;    // Size of the bss section.
+    std::size_t initArray = 0;  // DT_INIT_ARRAY entries, pointing to the first function.
+    std::size_t finiArray = 0;  // DT_FINI_ARRAY entries, pointing to the first function.
+    bool gnuHash = true;        // Emit DT_GNU_HASH, DT_HASH is always emitted.
+    DepSpec deps;
+};
+
+bool parseSpecFile(const std::filesystem::path& path, ObjectSpec& out);
+
+} // namespace elfgen
+
+#endif /* _ELFGEN_SPEC_H */
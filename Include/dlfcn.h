@@ -6,15 +6,77 @@
 #include <stdio.h>
 
 #define RTLD_LOCAL 0x0000
-#define RTLD_LAZY 0x0001     // Unsupported.
+#define RTLD_LAZY 0x0001
 #define RTLD_NOW 0x0002
 #define RTLD_NOLOAD 0x0004
 #define RTLD_DEEPBIND 0x0008 // Unsupported.
 #define RTLD_GLOBAL 0x0100
 #define RTLD_NODELETE 0x1000 // Unsupported.
 
+#define CTRDL_MAP_DONATE 0x10000 // ctrdlMap only: on success, take ownership of a page-aligned, heap-allocated buffer and use it as code pages; on failure the caller keeps it.
+
+#define CTRDL_ASYNC_PRIORITY_DEFAULT -1 // Inherit the priority of the calling thread.
+
+// GNU hash of a string literal of up to 64 characters, folded at compile time.
+#define CTRDL_GNU_HASH(s) ((u32)(0 * sizeof(char[(sizeof(s) <= 65) ? 1 : -1]) + _CTRDL_GNU_HASH_64(5381u, s, 0u)))
+
+#define CTRDL_ELF_HASH_NONE 0xFFFFFFFF // Unknown ELF hash, computed once if needed. ELF hashes never have the top bits set.
+
+// Looks up a string literal without hashing it at runtime, C only folds the GNU hash.
+#if defined(__cplusplus)
+#define ctrdlSymConst(handle, s) ctrdlSymHashed((handle), (s), sizeof(s) - 1, CTRDL_GNU_HASH(s), CTRDL_ELF_HASH(s))
+#else
+#define ctrdlSymConst(handle, s) ctrdlSymHashed((handle), (s), sizeof(s) - 1, CTRDL_GNU_HASH(s), CTRDL_ELF_HASH_NONE)
+#endif // __cplusplus
+
+// Characters past the end of the literal leave the hash unchanged.
+#define _CTRDL_GNU_HASH_IN(s, i) ((i) < (sizeof(s) - 1))
+#define _CTRDL_GNU_HASH_1(h, s, i) \
+    ((h) * (_CTRDL_GNU_HASH_IN(s, i) ? 33u : 1u) + (_CTRDL_GNU_HASH_IN(s, i) ? (u8)(s)[_CTRDL_GNU_HASH_IN(s, i) ? (i) : 0] : 0u))
+#define _CTRDL_GNU_HASH_2(h, s, i) _CTRDL_GNU_HASH_1(_CTRDL_GNU_HASH_1(h, s, i), s, (i) + 1)
+#define _CTRDL_GNU_HASH_4(h, s, i) _CTRDL_GNU_HASH_2(_CTRDL_GNU_HASH_2(h, s, i), s, (i) + 2)
+#define _CTRDL_GNU_HASH_8(h, s, i) _CTRDL_GNU_HASH_4(_CTRDL_GNU_HASH_4(h, s, i), s, (i) + 4)
+#define _CTRDL_GNU_HASH_16(h, s, i) _CTRDL_GNU_HASH_8(_CTRDL_GNU_HASH_8(h, s, i), s, (i) + 8)
+#define _CTRDL_GNU_HASH_32(h, s, i) _CTRDL_GNU_HASH_16(_CTRDL_GNU_HASH_16(h, s, i), s, (i) + 16)
+#define _CTRDL_GNU_HASH_64(h, s, i) _CTRDL_GNU_HASH_32(_CTRDL_GNU_HASH_32(h, s, i), s, (i) + 32)
+
+typedef struct CTRDLAsync CTRDLAsync;
+
 typedef void*(*CTRDLResolverFn)(const char* sym, void* userData);
 typedef void(*CTRDLEnumerateFn)(void* handle);
+typedef void(*CTRDLAsyncCallback)(CTRDLAsync* job, void* handle, void* userData);
+
+typedef enum {
+    CTRDL_PHASE_OPEN,    // Opening dependency files.
+    CTRDL_PHASE_PARSE,   // Parsing headers and dynamic entries.
+    CTRDL_PHASE_DEPS,    // Finding or creating dependencies.
+    CTRDL_PHASE_ALLOC,   // Allocating and committing code pages.
+    CTRDL_PHASE_READ,    // Reading segments.
+    CTRDL_PHASE_RELOC,   // Resolving symbols and applying relocations.
+    CTRDL_PHASE_PROTECT, // Changing memory permissions.
+    CTRDL_PHASE_CACHE,   // Flushing the data cache and invalidating the instruction cache.
+    CTRDL_PHASE_INIT,    // Running initializers.
+    CTRDL_NUM_PHASES,
+} CTRDLLoadPhase;
+
+typedef enum {
+    CTRDL_SCOPE_RESOLVER, // Custom resolver.
+    CTRDL_SCOPE_PROGRAM,  // ctrdlProgramResolver.
+    CTRDL_SCOPE_GLOBAL,   // RTLD_GLOBAL objects.
+    CTRDL_SCOPE_SELF,     // The object itself.
+    CTRDL_SCOPE_DEPS,     // Dependencies.
+    CTRDL_SCOPE_NONE,     // Not found, weak references only.
+    CTRDL_NUM_SCOPES,
+} CTRDLSymScope;
+
+typedef struct {
+    CTRDLResolverFn resolver;     // Resolver (optional).
+    void* resolverUserData;       // Resolver user data.
+    CTRDLAsyncCallback callback;  // Completion callback, called from the loader thread once the job is complete (optional).
+    void* callbackUserData;       // Callback user data.
+    s32 priority;                 // Loader thread priority.
+    bool deferInit;               // Leave initializers to ctrdlAsyncRunInit.
+} CTRDLAsyncOptions;
 
 typedef struct {
     const char* dli_fname; // Object path.
@@ -24,12 +86,36 @@ typedef struct {
 } Dl_info;
 
 typedef struct {
-    char* path;      // Path.
-    size_t pathSize; // Path size.
-    u32 base;        // Base address.
-    size_t size;     // Size.
+    char* path;             // Path.
+    size_t pathSize;        // Path size.
+    u32 base;               // Base address.
+    size_t size;            // Size.
+    size_t numSeeks;        // Stream seeks issued while loading.
+    size_t numReads;        // Stream reads issued while loading.
+    size_t numAllocs;       // Metadata allocations made while loading.
+    size_t numRelocs;       // Relocations applied while loading.
+    size_t numResolvedSyms; // Distinct symbols resolved while loading.
 } CTRDLInfo;
 
+typedef struct {
+    size_t numRegions; // Code regions shared by small objects.
+    size_t numObjects; // Objects placed in shared regions.
+    size_t regionSize; // Size of shared regions.
+    size_t usedSize;   // Bytes used by placed objects, the rest is lost to fragmentation.
+} CTRDLCodeStats;
+
+typedef struct {
+    u64 ticks[CTRDL_NUM_PHASES];          // System ticks spent in each phase, summed over threads.
+    u64 totalTicks;                       // System ticks from the start of the load until the object was ready.
+    size_t numObjects;                    // Objects loaded.
+    size_t bytesRead;                     // Bytes read from streams.
+    size_t bytesMapped;                   // Bytes of code pages used.
+    size_t numRelocs;                     // Relocations applied.
+    size_t numResolved[CTRDL_NUM_SCOPES]; // Distinct symbols resolved, by scope.
+} CTRDLLoadStats;
+
+typedef void(*CTRDLLoadStatsCallback)(void* handle, const CTRDLLoadStats* stats, void* userData);
+
 #if defined(__cplusplus)
 extern "C" {
 #endif // __cplusplus
@@ -44,14 +130,39 @@ void* ctrdlProgramResolver(const char* sym);
 void* ctrdlOpen(const char* path, int flags, CTRDLResolverFn resolver, void* resolverUserData);
 void* ctrdlFOpen(FILE* f, int flags, CTRDLResolverFn resolver, void* resolverUserData);
 void* ctrdlMap(const void* buffer, size_t size, int flags, CTRDLResolverFn resolver, void* resolverUserData);
+void* ctrdlSymHashed(void* handle, const char* name, size_t len, u32 gnuHash, u32 elfHash);
+bool ctrdlSymBatch(void* handle, const char* const* names, size_t count, void** out);
 void* ctrdlHandleByAddress(u32 addr);
 void* ctrdlThisHandle(void);
 void ctrdlEnumerate(CTRDLEnumerateFn callback);
 bool ctrdlInfo(void* handle, CTRDLInfo* info);
 void ctrdlFreeInfo(CTRDLInfo* info);
+bool ctrdlCodeStats(CTRDLCodeStats* stats);
+bool ctrdlSetNumWorkers(size_t numWorkers);
+bool ctrdlSetPipelineChunkSize(size_t size);
+bool ctrdlGetLoadStats(void* handle, CTRDLLoadStats* stats);
+bool ctrdlSetLoadStatsCallback(CTRDLLoadStatsCallback callback, void* userData);
+
+CTRDLAsync* ctrdlOpenAsync(const char* path, int flags, const CTRDLAsyncOptions* options);
+bool ctrdlAsyncPoll(CTRDLAsync* job);
+void* ctrdlAsyncWait(CTRDLAsync* job);
+void ctrdlAsyncCancel(CTRDLAsync* job);
+bool ctrdlAsyncRunInit(CTRDLAsync* job);
+void ctrdlAsyncFree(CTRDLAsync* job);
 
 #if defined(__cplusplus)
 }
+
+// ELF (SysV) hash, usable in constant expressions.
+constexpr u32 _ctrdlElfHashStep(u32 h) { return (h ^ ((h & 0xF0000000u) >> 24)) & 0x0FFFFFFFu; }
+constexpr u32 _ctrdlElfHash(const char* s, u32 h) { return *s ? _ctrdlElfHash(s + 1, _ctrdlElfHashStep((h << 4) + (u8)*s)) : h; }
+constexpr u32 ctrdlElfHash(const char* s) { return _ctrdlElfHash(s, 0); }
+
+template <u32 Hash>
+struct _CTRDLConstHash { static constexpr u32 value = Hash; };
+
+// ELF hash of a string literal, folded at compile time.
+#define CTRDL_ELF_HASH(s) (_CTRDLConstHash<ctrdlElfHash(s)>::value)
 #endif // cplusplus
 
 #endif /* _CTRDL_DLFCN_H */
\ No newline at end of file
@@ -7,10 +7,13 @@
 #include <CTRL/App.h>
 #include <CTRL/Memory.h>
 
+#include "Async.h"
+#include "CodeRegion.h"
 #include "Handle.h"
 #include "Error.h"
 #include "Loader.h"
 #include "Symbol.h"
+#include "Worker.h"
 
 #include <sys/stat.h>
 #include <stdlib.h>
@@ -20,11 +23,11 @@ __attribute__((weak)) void* ctrdlProgramResolver(const char* symName) { return N
 
 static bool ctrdl_checkFlags(int flags) {
     // Unsupported flags.
-    if (flags & (RTLD_LAZY | RTLD_DEEPBIND | RTLD_NODELETE))
+    if (flags & (RTLD_DEEPBIND | RTLD_NODELETE))
         return false;
 
-    // Required flags.
-    if (!(flags & RTLD_NOW))
+    // Required flags, RTLD_NOW takes precedence.
+    if (!(flags & (RTLD_LAZY | RTLD_NOW)))
         return false;
 
     return true;
@@ -33,40 +36,40 @@ static bool ctrdl_checkFlags(int flags) {
 void* dlopen(const char* path, int flags) { return ctrdlOpen(path, flags, NULL, NULL); }
 const char* dlerror(void) { return ctrdl_getErrorAsString(ctrdl_getLastError()); }
 
-int dlclose(void* handle) {
-    if (handle != CTRDL_MAIN_HANDLE)
-        return !ctrdl_unlockHandle((CTRDLHandle*)handle);
+// Handles are opaque ids, closed ones are rejected; the main handle is resolved by callers.
+static CTRDLHandle* ctrdl_resolveHandle(void* handle) {
+    CTRDLHandle* h = ctrdl_getHandleById(handle);
+    if (!h)
+        ctrdl_setLastError(Err_InvalidParam);
 
-    return 0;
+    return h;
 }
 
-void* dlsym(void* handle, const char* name) {
-    if (!handle || !name) {
-        ctrdl_setLastError(Err_InvalidParam);
-        return NULL;
-    }
+int dlclose(void* handle) {
+    if (handle == CTRDL_MAIN_HANDLE)
+        return 0;
 
+    CTRDLHandle* h = ctrdl_resolveHandle(handle);
+    return h ? !ctrdl_unlockHandle(h) : 1;
+}
+
+static void* ctrdl_symLookup(void* handle, CTRDLSymKey* key) {
     // Handle main handle (load order).
     if (handle == CTRDL_MAIN_HANDLE) {
         // Look into program symbols.
-        void* addr = ctrdlProgramResolver(name);
+        void* addr = ctrdlProgramResolver(key->name);
 
         if (!addr) {
-            // Look into global objects.
-            ctrdl_acquireHandleMtx();
-
-            for (size_t i = 0; i < ctrdl_unsafeNumHandles(); ++i) {
-                CTRDLHandle* h = ctrdl_unsafeGetHandleByIndex(i);
-                if (h->flags & RTLD_GLOBAL) {
-                    const Elf32_Sym* sym = ctrdl_symNameLookupSingle(h, name);
-                    if (sym) {
-                        addr = (void*)(h->base + sym->st_value);
-                        break;
-                    }
-                }
-            }
-
-            ctrdl_releaseHandleMtx();
+            // Look into global objects, which may be unloaded once the read ends.
+            u32 phase;
+            ctrdl_beginRead(&phase);
+
+            u32 base = 0;
+            const Elf32_Sym* sym = ctrdl_symNameLookupGlobal(key, &base);
+            if (sym)
+                addr = (void*)(base + sym->st_value);
+
+            ctrdl_endRead(phase);
         }
 
         if (!addr)
@@ -76,42 +79,58 @@ void* dlsym(void* handle, const char* name) {
     }
 
     // Handle other handles (dep order).
-    CTRDLHandle* h = (CTRDLHandle*)handle;
-    const Elf32_Sym* sym = ctrdl_symNameLookupDepOrder(h, name);
+    CTRDLHandle* h = ctrdl_resolveHandle(handle);
+    if (!h)
+        return NULL;
+
+    u32 base = 0;
+    const Elf32_Sym* sym = ctrdl_symNameLookupDepOrder(h, key, &base);
     if (sym)
-        return (void*)(h->base + sym->st_value);
+        return (void*)(base + sym->st_value);
 
     ctrdl_setLastError(Err_NotFound);
     return NULL;
 }
 
+void* dlsym(void* handle, const char* name) {
+    if (!handle || !name) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return NULL;
+    }
+
+    CTRDLSymKey key;
+    ctrdl_makeELFSymKey(&key, name);
+    return ctrdl_symLookup(handle, &key);
+}
+
 int dladdr(const void* address, Dl_info* info) {
     if (!info)
         return 0;
 
     const u32 addr = (u32)address;
-    CTRDLHandle* h = ctrdlHandleByAddress(addr);
-    if (h) {
-        info->dli_fname = h->path;
-        info->dli_fbase = (void*)h->base;
-
-        const Elf32_Sym* sym = ctrdl_symValueLookupSingle(h, addr - h->base);
-        if (sym) {
-            info->dli_sname = &h->stringTable[sym->st_name];
-            info->dli_saddr = (void*)(h->base + sym->st_value);
-        } else {
-            info->dli_sname = NULL;
-            info->dli_saddr = NULL;
-        }
+    CTRDLHandle* h = ctrdl_lockHandleByAddr(addr);
+    if (!h)
+        return 0;
+
+    info->dli_fname = h->path;
+    info->dli_fbase = (void*)h->base;
 
-        ctrdl_unlockHandle(h);
+    // The offset into the symbol is addr - dli_saddr.
+    const Elf32_Sym* sym = ctrdl_symValueLookupSingle(h, addr - h->base);
+    if (sym) {
+        info->dli_sname = &h->symTable.stringTable[sym->st_name];
+        info->dli_saddr = (void*)(h->base + ((ELF32_ST_TYPE(sym->st_info) == STT_FUNC) ? (sym->st_value & ~1) : sym->st_value));
+    } else {
+        info->dli_sname = NULL;
+        info->dli_saddr = NULL;
     }
 
-    return info->dli_fbase != NULL;
+    ctrdl_unlockHandle(h);
+    return 1;
 }
 
 void* ctrdlOpen(const char* path, int flags, CTRDLResolverFn resolver, void* resolverUserData) {
-    if (!ctrdl_checkFlags(flags)) {
+    if (!ctrdl_checkFlags(flags) || (flags & CTRDL_MAP_DONATE)) {
         ctrdl_setLastError(Err_InvalidParam);
         return NULL;
     }
@@ -119,77 +138,127 @@ void* ctrdlOpen(const char* path, int flags, CTRDLResolverFn resolver, void* res
     if (!path)
         return CTRDL_MAIN_HANDLE;
 
-    // Avoid reading if already open.
-    ctrdl_acquireHandleMtx();
-    CTRDLHandle* handle = ctrdl_unsafeFindHandleByName(path);
-
-    if (handle) {
-        ctrdl_lockHandle(handle);
-
-        // Update flags.
-        // Once GLOBAL, forever GLOBAL.
-        if (handle->flags & RTLD_GLOBAL)
-            flags &= ~(RTLD_LOCAL);
+    return ctrdl_getHandleId(ctrdl_openObject(path, flags, resolver, resolverUserData, NULL));
+}
 
-        handle->flags = (flags & ~(RTLD_NOLOAD));
-        ctrdl_releaseHandleMtx();
-        return (void*)handle;
+void* ctrdlFOpen(FILE* f, int flags, CTRDLResolverFn resolver, void* resolverUserData) {
+    if (!f || !ctrdl_checkFlags(flags) || (flags & (RTLD_NOLOAD | CTRDL_MAP_DONATE))) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return NULL;
     }
 
-    ctrdl_releaseHandleMtx();
+    CTRDLStream stream;
+    ctrdl_makeFileStream(&stream, f);
+    return ctrdl_getHandleId(ctrdl_loadObject(NULL, 0, flags, &stream, resolver, resolverUserData, NULL));
+}
 
-    if (flags & RTLD_NOLOAD) {
-        ctrdl_setLastError(Err_NotFound);
+void* ctrdlMap(const void* buffer, size_t size, int flags, CTRDLResolverFn resolver, void* resolverUserData) {
+    if (!buffer || !size || !ctrdl_checkFlags(flags) || (flags & RTLD_NOLOAD)) {
+        ctrdl_setLastError(Err_InvalidParam);
         return NULL;
     }
 
-    // Open file for reading.
-    FILE* f = fopen(path, "rb");
-    if (!f) {
-        ctrdl_setLastError(Err_NotFound);
+    if ((flags & CTRDL_MAP_DONATE) && ((u32)buffer & (CTRL_PAGE_SIZE - 1))) {
+        ctrdl_setLastError(Err_InvalidParam);
         return NULL;
     }
 
     CTRDLStream stream;
-    ctrdl_makeFileStream(&stream, f);
-    handle = ctrdl_loadObject(path, flags, &stream, resolver, resolverUserData);
+    ctrdl_makeMemStream(&stream, buffer, size);
+    CTRDLHandle* handle = ctrdl_loadObject(NULL, 0, flags, &stream, resolver, resolverUserData, NULL);
+
+    // Donated buffers which could not be adopted are no longer needed.
+    if (handle && (flags & CTRDL_MAP_DONATE) && !handle->donated)
+        free((void*)buffer);
 
-    fclose(f);
-    return handle;
+    return ctrdl_getHandleId(handle);
 }
 
-void* ctrdlFOpen(FILE* f, int flags, CTRDLResolverFn resolver, void* resolverUserData) {
-    if (!f || !ctrdl_checkFlags(flags) || (flags & RTLD_NOLOAD)) {
+void* ctrdlSymHashed(void* handle, const char* name, size_t len, u32 gnuHash, u32 elfHash) {
+    if (!handle || !name) {
         ctrdl_setLastError(Err_InvalidParam);
         return NULL;
     }
 
-    CTRDLStream stream;
-    ctrdl_makeFileStream(&stream, f);
-    return ctrdl_loadObject(NULL, flags, &stream, resolver, resolverUserData);
+    CTRDLSymKey key;
+    ctrdl_makeELFSymKeyHashed(&key, name, len, gnuHash, elfHash);
+    return ctrdl_symLookup(handle, &key);
 }
 
-void* ctrdlMap(const void* buffer, size_t size, int flags, CTRDLResolverFn resolver, void* resolverUserData) {
-    if (!buffer || !size || !ctrdl_checkFlags(flags) || (flags & RTLD_NOLOAD)) {
+bool ctrdlSymBatch(void* handle, const char* const* names, size_t count, void** out) {
+    if (!handle || !names || !out) {
         ctrdl_setLastError(Err_InvalidParam);
-        return NULL;
+        return false;
     }
 
-    CTRDLStream stream;
-    ctrdl_makeMemStream(&stream, buffer, size);
-    return ctrdl_loadObject(NULL, flags, &stream, resolver, resolverUserData);
-}
+    for (size_t i = 0; i < count; ++i) {
+        if (!names[i]) {
+            ctrdl_setLastError(Err_InvalidParam);
+            return false;
+        }
+    }
 
-void* ctrdlHandleByAddress(u32 addr) {
-    ctrdl_acquireHandleMtx();
-    CTRDLHandle* handle = ctrdl_unsafeFindHandleByAddr(addr);
-    if (handle) {
-        ctrdl_lockHandle(handle);
+    CTRDLHandle* h = NULL;
+    if ((handle != CTRDL_MAIN_HANDLE) && !(h = ctrdl_resolveHandle(handle)))
+        return false;
+
+    CTRDLSymBatchEntry* entries = malloc((count ? count : 1) * (sizeof(CTRDLSymBatchEntry) + sizeof(size_t)));
+    if (!entries) {
+        ctrdl_setLastError(Err_NoMemory);
+        return false;
+    }
+
+    size_t* indices = (size_t*)&entries[count ? count : 1];
+    size_t numEntries = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        // Program symbols take precedence for the main handle.
+        out[i] = (handle == CTRDL_MAIN_HANDLE) ? ctrdlProgramResolver(names[i]) : NULL;
+        if (out[i])
+            continue;
+
+        CTRDLSymBatchEntry* entry = &entries[numEntries];
+        ctrdl_makeELFSymKey(&entry->key, names[i]);
+        entry->sym = NULL;
+        entry->modBase = 0;
+        indices[numEntries++] = i;
+    }
+
+    // Global objects may be unloaded once the read ends.
+    u32 phase;
+    ctrdl_beginRead(&phase);
+
+    size_t missing = 0;
+    if (handle == CTRDL_MAIN_HANDLE) {
+        missing = ctrdl_symNameLookupGlobalBatch(entries, numEntries);
     } else {
+        missing = ctrdl_symNameLookupDepOrderBatch(h, entries, numEntries);
+    }
+
+    for (size_t i = 0; i < numEntries; ++i) {
+        const CTRDLSymBatchEntry* entry = &entries[i];
+        if (entry->sym)
+            out[indices[i]] = (void*)(entry->modBase + entry->sym->st_value);
+    }
+
+    ctrdl_endRead(phase);
+
+    free(entries);
+
+    if (missing) {
         ctrdl_setLastError(Err_NotFound);
+        return false;
     }
-    ctrdl_releaseHandleMtx();
-    return handle;
+
+    return true;
+}
+
+void* ctrdlHandleByAddress(u32 addr) {
+    CTRDLHandle* handle = ctrdl_lockHandleByAddr(addr);
+    if (!handle)
+        ctrdl_setLastError(Err_NotFound);
+
+    return ctrdl_getHandleId(handle);
 }
 
 void* ctrdlThisHandle(void) {
@@ -212,8 +281,8 @@ void ctrdlEnumerate(CTRDLEnumerateFn callback) {
 
     ctrdl_acquireHandleMtx();
 
-    for (size_t i = 0; i < ctrdl_unsafeNumHandles(); ++i)
-        callback(ctrdl_unsafeGetHandleByIndex(i));
+    for (CTRDLHandle* h = ctrdl_unsafeNextHandle(NULL); h; h = ctrdl_unsafeNextHandle(h))
+        callback(ctrdl_getHandleId(h));
 
     ctrdl_releaseHandleMtx();
 }
@@ -230,11 +299,23 @@ bool ctrdlInfo(void* handle, CTRDLInfo* info) {
         info->pathSize = 0;
         info->base = appSectionInfo->textAddr;
         info->size = appSectionInfo->textSize + appSectionInfo->rodataSize + appSectionInfo->dataSize;
+        info->numSeeks = 0;
+        info->numReads = 0;
+        info->numAllocs = 0;
+        info->numRelocs = 0;
+        info->numResolvedSyms = 0;
         return true;
     }
 
-    CTRDLHandle* h = (CTRDLHandle*)handle;
-    ctrdl_lockHandle(h);
+    // The handle may be closed meanwhile, its last reference can't be revived.
+    CTRDLHandle* h = ctrdl_resolveHandle(handle);
+    if (!h)
+        return false;
+
+    if (!ctrdl_tryLockHandle(h)) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return false;
+    }
 
     bool success = true;
     if (h->path) {
@@ -253,7 +334,12 @@ bool ctrdlInfo(void* handle, CTRDLInfo* info) {
     }
 
     info->base = h->base;
-    info->size = ctrlNumPagesToSize(h->numPages);
+    info->size = h->size;
+    info->numSeeks = h->numSeeks;
+    info->numReads = h->numReads;
+    info->numAllocs = h->numAllocs;
+    info->numRelocs = h->numRelocs;
+    info->numResolvedSyms = h->numResolvedSyms;
 
     ctrdl_unlockHandle(h);
     return success;
@@ -262,4 +348,120 @@ bool ctrdlInfo(void* handle, CTRDLInfo* info) {
 void ctrdlFreeInfo(CTRDLInfo* info) {
     if (info)
         free(info->path);
+}
+
+bool ctrdlCodeStats(CTRDLCodeStats* stats) {
+    if (!stats) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return false;
+    }
+
+    ctrdl_acquireHandleMtx();
+    ctrdl_getCodeStats(stats);
+    ctrdl_releaseHandleMtx();
+    return true;
+}
+
+bool ctrdlSetNumWorkers(size_t numWorkers) {
+    if (!ctrdl_setNumWorkers(numWorkers)) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return false;
+    }
+
+    return true;
+}
+
+bool ctrdlSetPipelineChunkSize(size_t size) {
+    if (!ctrdl_setPipelineChunkSize(size)) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return false;
+    }
+
+    return true;
+}
+
+bool ctrdlGetLoadStats(void* handle, CTRDLLoadStats* stats) {
+#ifdef CTRDL_LOAD_STATS
+    if (!handle || !stats) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return false;
+    }
+
+    // The program is not loaded by us.
+    if (handle == CTRDL_MAIN_HANDLE) {
+        memset(stats, 0, sizeof(CTRDLLoadStats));
+        return true;
+    }
+
+    CTRDLHandle* h = ctrdl_resolveHandle(handle);
+    if (!h)
+        return false;
+
+    if (!ctrdl_tryLockHandle(h)) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return false;
+    }
+
+    *stats = h->loadStats;
+    ctrdl_unlockHandle(h);
+    return true;
+#else
+    ctrdl_setLastError(Err_NotSupported);
+    return false;
+#endif // CTRDL_LOAD_STATS
+}
+
+bool ctrdlSetLoadStatsCallback(CTRDLLoadStatsCallback callback, void* userData) {
+    if (!ctrdl_setLoadStatsCallback(callback, userData)) {
+        ctrdl_setLastError(Err_NotSupported);
+        return false;
+    }
+
+    return true;
+}
+
+CTRDLAsync* ctrdlOpenAsync(const char* path, int flags, const CTRDLAsyncOptions* options) {
+    if (!path || !ctrdl_checkFlags(flags) || (flags & CTRDL_MAP_DONATE)) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return NULL;
+    }
+
+    return ctrdl_asyncOpen(path, flags, options);
+}
+
+bool ctrdlAsyncPoll(CTRDLAsync* job) {
+    if (!job) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return false;
+    }
+
+    return ctrdl_asyncPoll(job);
+}
+
+void* ctrdlAsyncWait(CTRDLAsync* job) {
+    if (!job) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return NULL;
+    }
+
+    return ctrdl_getHandleId(ctrdl_asyncWait(job));
+}
+
+void ctrdlAsyncCancel(CTRDLAsync* job) {
+    if (job)
+        ctrdl_asyncCancel(job);
+}
+
+bool ctrdlAsyncRunInit(CTRDLAsync* job) {
+    if (!job) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return false;
+    }
+
+    return ctrdl_asyncRunInit(job);
+}
+
+void ctrdlAsyncFree(CTRDLAsync* job) {
+    if (job)
+        ctrdl_asyncFree(job);
 }
\ No newline at end of file
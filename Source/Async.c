@@ -0,0 +1,125 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Async.h"
+#include "Error.h"
+#include "Loader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CTRDL_ASYNC_STACK_SIZE
+#define CTRDL_ASYNC_STACK_SIZE 0x8000
+#endif // CTRDL_ASYNC_STACK_SIZE
+
+struct CTRDLAsync {
+    char* path;                 // Object path.
+    int flags;                  // Object flags.
+    CTRDLAsyncOptions options;  // Job options.
+    volatile bool cancelled;    // Set by ctrdl_asyncCancel.
+    Thread thread;              // Loader thread.
+    LightEvent done;            // Signaled once the load completes.
+    CTRDLHandle* handle;        // Loaded object.
+    CTRDLError error;           // Errors are thread local, the loader thread reports them here.
+};
+
+static void ctrdl_asyncMain(void* arg) {
+    CTRDLAsync* job = (CTRDLAsync*)arg;
+
+    CTRDLLoadOptions options;
+    options.cancelled = &job->cancelled;
+    options.deferInit = job->options.deferInit;
+
+    ctrdl_clearLastError();
+    job->handle = ctrdl_openObject(job->path, job->flags, job->options.resolver, job->options.resolverUserData, &options);
+    job->error = job->handle ? Err_OK : ctrdl_getLastError();
+
+    // The job is complete before the callback runs, so that it may poll, wait or run initializers.
+    // ctrdl_asyncFree joins this thread, the job outlives the callback.
+    LightEvent_Signal(&job->done);
+
+    if (job->options.callback)
+        job->options.callback(job, ctrdl_getHandleId(job->handle), job->options.callbackUserData);
+}
+
+CTRDLAsync* ctrdl_asyncOpen(const char* path, int flags, const CTRDLAsyncOptions* options) {
+    CTRDLAsync* job = malloc(sizeof(CTRDLAsync));
+    if (!job) {
+        ctrdl_setLastError(Err_NoMemory);
+        return NULL;
+    }
+
+    const size_t pathSize = strlen(path);
+    job->path = malloc(pathSize + 1);
+    if (!job->path) {
+        ctrdl_setLastError(Err_NoMemory);
+        free(job);
+        return NULL;
+    }
+
+    memcpy(job->path, path, pathSize);
+    job->path[pathSize] = '\0';
+    job->flags = flags;
+
+    if (options) {
+        job->options = *options;
+    } else {
+        memset(&job->options, 0, sizeof(CTRDLAsyncOptions));
+        job->options.priority = CTRDL_ASYNC_PRIORITY_DEFAULT;
+    }
+
+    job->cancelled = false;
+    job->handle = NULL;
+    job->error = Err_OK;
+    LightEvent_Init(&job->done, RESET_STICKY);
+
+    s32 priority = job->options.priority;
+    if (priority == CTRDL_ASYNC_PRIORITY_DEFAULT) {
+        priority = 0x30;
+        svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+    }
+
+    job->thread = threadCreate(ctrdl_asyncMain, job, CTRDL_ASYNC_STACK_SIZE, priority, -2, false);
+    if (!job->thread) {
+        ctrdl_setLastError(Err_NoMemory);
+        free(job->path);
+        free(job);
+        return NULL;
+    }
+
+    return job;
+}
+
+bool ctrdl_asyncPoll(CTRDLAsync* job) { return LightEvent_TryWait(&job->done); }
+
+CTRDLHandle* ctrdl_asyncWait(CTRDLAsync* job) {
+    LightEvent_Wait(&job->done);
+
+    if (!job->handle)
+        ctrdl_setLastError(job->error);
+
+    return job->handle;
+}
+
+// Only loads in progress are affected.
+void ctrdl_asyncCancel(CTRDLAsync* job) { job->cancelled = true; }
+
+bool ctrdl_asyncRunInit(CTRDLAsync* job) {
+    CTRDLHandle* handle = ctrdl_asyncWait(job);
+    if (!handle)
+        return false;
+
+    ctrdl_runInitializers(handle);
+    return true;
+}
+
+void ctrdl_asyncFree(CTRDLAsync* job) {
+    LightEvent_Wait(&job->done);
+    threadJoin(job->thread, U64_MAX);
+    threadFree(job->thread);
+    free(job->path);
+    free(job);
+}
@@ -0,0 +1,19 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _CTRDL_ASYNC_H
+#define _CTRDL_ASYNC_H
+
+#include "Handle.h"
+
+CTRDLAsync* ctrdl_asyncOpen(const char* path, int flags, const CTRDLAsyncOptions* options);
+bool ctrdl_asyncPoll(CTRDLAsync* job);
+CTRDLHandle* ctrdl_asyncWait(CTRDLAsync* job);
+void ctrdl_asyncCancel(CTRDLAsync* job);
+bool ctrdl_asyncRunInit(CTRDLAsync* job);
+void ctrdl_asyncFree(CTRDLAsync* job);
+
+#endif /* _CTRDL_ASYNC_H */
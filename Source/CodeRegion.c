@@ -0,0 +1,222 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <CTRL/CodeAllocator.h>
+#include <CTRL/Memory.h>
+
+#include "CodeRegion.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static CTRDLCodeRegion* g_Regions = NULL;
+
+static inline size_t ctrdl_firstPage(size_t offset) { return offset / CTRL_PAGE_SIZE; }
+static inline size_t ctrdl_lastPage(size_t end) { return (end - 1) / CTRL_PAGE_SIZE; }
+
+static bool ctrdl_canPlace(CTRDLPackLayout** placed, size_t numPlaced, const u8* pagePerms, const CTRDLPackLayout* layout, size_t offset) {
+    for (size_t i = 0; i < layout->numSegments; ++i) {
+        const CTRDLPackSegment* s = &layout->segments[i];
+        const size_t begin = offset + s->begin;
+        const size_t end = offset + s->end;
+
+        // Bytes must be free.
+        for (size_t j = 0; j < numPlaced; ++j) {
+            for (size_t k = 0; k < placed[j]->numSegments; ++k) {
+                const CTRDLPackSegment* other = &placed[j]->segments[k];
+                if ((begin < (placed[j]->offset + other->end)) && ((placed[j]->offset + other->begin) < end))
+                    return false;
+            }
+        }
+
+        // Pages must have the same permissions, including those shared with other segments of the same object.
+        for (size_t page = ctrdl_firstPage(begin); page <= ctrdl_lastPage(end); ++page) {
+            if (pagePerms[page] && (pagePerms[page] != s->perms))
+                return false;
+        }
+
+        for (size_t j = 0; j < i; ++j) {
+            const CTRDLPackSegment* prev = &layout->segments[j];
+            if ((prev->perms != s->perms) && (ctrdl_lastPage(offset + prev->end) >= ctrdl_firstPage(begin)) &&
+                (ctrdl_firstPage(offset + prev->begin) <= ctrdl_lastPage(end)))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static size_t ctrdl_placeLayout(CTRDLPackLayout** placed, size_t numPlaced, const u8* pagePerms, size_t regionEnd, const CTRDLPackLayout* layout) {
+    // Fresh pages always fit a well formed object.
+    size_t best = ctrlAlignUp(regionEnd, CTRL_PAGE_SIZE);
+    if (!ctrdl_canPlace(placed, numPlaced, pagePerms, layout, best))
+        return CTRDL_PACK_NOT_PLACED;
+
+    if (ctrdl_canPlace(placed, numPlaced, pagePerms, layout, 0))
+        return 0;
+
+    // Otherwise try right after each placed segment.
+    for (size_t i = 0; i < numPlaced; ++i) {
+        for (size_t j = 0; j < placed[i]->numSegments; ++j) {
+            const size_t end = placed[i]->offset + placed[i]->segments[j].end;
+
+            for (size_t k = 0; k < layout->numSegments; ++k) {
+                if (end < layout->segments[k].begin)
+                    continue;
+
+                const size_t offset = ctrlAlignUp(end - layout->segments[k].begin, CTRDL_PACK_ALIGN);
+                if ((offset < best) && ctrdl_canPlace(placed, numPlaced, pagePerms, layout, offset))
+                    best = offset;
+            }
+        }
+    }
+
+    return best;
+}
+
+CTRDLCodeRegion* ctrdl_packObjects(CTRDLPackLayout** layouts, size_t numLayouts) {
+    CTRDLPackLayout* order[CTRDL_PACK_MAX_OBJECTS];
+    size_t maxPages = 0;
+
+    if (numLayouts > CTRDL_PACK_MAX_OBJECTS)
+        numLayouts = CTRDL_PACK_MAX_OBJECTS;
+
+    // Larger objects are placed first.
+    for (size_t i = 0; i < numLayouts; ++i) {
+        CTRDLPackLayout* layout = layouts[i];
+        layout->offset = CTRDL_PACK_NOT_PLACED;
+        maxPages += ctrlSizeToNumPages(layout->size) + 1; // Unaligned objects may span one more page.
+
+        size_t j = i;
+        while (j && (order[j - 1]->size < layout->size)) {
+            order[j] = order[j - 1];
+            --j;
+        }
+
+        order[j] = layout;
+    }
+
+    u8* pagePerms = calloc(maxPages ? maxPages : 1, sizeof(u8));
+    if (!pagePerms)
+        return NULL;
+
+    CTRDLPackLayout* placed[CTRDL_PACK_MAX_OBJECTS];
+    size_t numPlaced = 0;
+    size_t regionEnd = 0;
+    size_t usedSize = 0;
+
+    for (size_t i = 0; i < numLayouts; ++i) {
+        CTRDLPackLayout* layout = order[i];
+        const size_t offset = ctrdl_placeLayout(placed, numPlaced, pagePerms, regionEnd, layout);
+        if (offset == CTRDL_PACK_NOT_PLACED)
+            continue;
+
+        layout->offset = offset;
+        for (size_t j = 0; j < layout->numSegments; ++j) {
+            const CTRDLPackSegment* s = &layout->segments[j];
+            for (size_t page = ctrdl_firstPage(offset + s->begin); page <= ctrdl_lastPage(offset + s->end); ++page)
+                pagePerms[page] = s->perms;
+        }
+
+        usedSize += layout->usedSize;
+        if ((offset + layout->size) > regionEnd)
+            regionEnd = offset + layout->size;
+
+        placed[numPlaced++] = layout;
+    }
+
+    const size_t numPages = ctrlSizeToNumPages(regionEnd);
+    CTRDLCodeRegion* region = numPlaced ? malloc(sizeof(CTRDLCodeRegion) + numPages) : NULL;
+
+    if (region && R_FAILED(ctrlAllocCodePages(numPages, &region->origin))) {
+        free(region);
+        region = NULL;
+    }
+
+    if (!region) {
+        for (size_t i = 0; i < numPlaced; ++i)
+            placed[i]->offset = CTRDL_PACK_NOT_PLACED;
+
+        free(pagePerms);
+        return NULL;
+    }
+
+    region->base = 0;
+    region->numPages = numPages;
+    region->numObjects = numPlaced;
+    region->usedSize = usedSize;
+    memcpy(region->pagePerms, pagePerms, numPages);
+    free(pagePerms);
+
+    region->next = g_Regions;
+    g_Regions = region;
+    return region;
+}
+
+bool ctrdl_commitRegion(CTRDLCodeRegion* region) {
+    // Committed once, by the first object to finish.
+    if (region->base)
+        return true;
+
+    u32 base;
+    if (R_FAILED(ctrlCommitCodePages(region->origin, region->numPages, &base)))
+        return false;
+
+    region->base = base;
+    return R_SUCCEEDED(ctrlChangeMemoryPerms(base, ctrlNumPagesToSize(region->numPages), MEMPERM_READWRITE));
+}
+
+bool ctrdl_protectRegion(CTRDLCodeRegion* region, const CTRDLPackLayout* layout) {
+    // Shared pages are protected as soon as one of their objects is ready, objects never write to pages of another class.
+    for (size_t i = 0; i < layout->numSegments; ++i) {
+        const CTRDLPackSegment* s = &layout->segments[i];
+        const size_t firstPage = ctrdl_firstPage(layout->offset + s->begin);
+        const size_t lastPage = ctrdl_lastPage(layout->offset + s->end);
+
+        if (R_FAILED(ctrlChangeMemoryPerms(region->base + ctrlNumPagesToSize(firstPage), ctrlNumPagesToSize(lastPage - firstPage + 1), s->perms)))
+            return false;
+    }
+
+    return true;
+}
+
+bool ctrdl_releaseRegion(CTRDLCodeRegion* region, size_t size) {
+    // Pages can't be reused while other objects may be running from them.
+    if (region->numObjects > 1) {
+        --region->numObjects;
+        region->usedSize -= size;
+        return true;
+    }
+
+    if (region->base) {
+        if (R_FAILED(ctrlReleaseCodePages(region->origin, region->base, region->numPages)))
+            return false;
+
+        region->base = 0;
+    }
+
+    if (R_FAILED(ctrlFreeCodePages(region->origin, region->numPages)))
+        return false;
+
+    CTRDLCodeRegion** link = &g_Regions;
+    while (*link != region)
+        link = &(*link)->next;
+
+    *link = region->next;
+    free(region);
+    return true;
+}
+
+void ctrdl_getCodeStats(CTRDLCodeStats* stats) {
+    memset(stats, 0, sizeof(CTRDLCodeStats));
+
+    for (const CTRDLCodeRegion* region = g_Regions; region; region = region->next) {
+        ++stats->numRegions;
+        stats->numObjects += region->numObjects;
+        stats->regionSize += ctrlNumPagesToSize(region->numPages);
+        stats->usedSize += region->usedSize;
+    }
+}
@@ -0,0 +1,61 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _CTRDL_CODEREGION_H
+#define _CTRDL_CODEREGION_H
+
+#include <dlfcn.h>
+
+#include "ELFUtil.h"
+
+#ifndef CTRDL_PACK_MAX_SIZE
+#define CTRDL_PACK_MAX_SIZE 0x4000 // Objects up to this size share code pages, 0 disables packing.
+#endif // CTRDL_PACK_MAX_SIZE
+
+#ifndef CTRDL_PACK_ALIGN
+#define CTRDL_PACK_ALIGN 0x40 // Alignment of packed objects, those with stricter sections are not packed.
+#endif // CTRDL_PACK_ALIGN
+
+#define CTRDL_PACK_MAX_OBJECTS 32
+#define CTRDL_PACK_NOT_PLACED ((size_t)-1)
+
+typedef struct {
+    size_t begin;  // Offset in the image.
+    size_t end;    // Offset past the segment.
+    MemPerm perms; // Segment permissions.
+} CTRDLPackSegment;
+
+typedef struct {
+    CTRDLPackSegment segments[CTRDL_MAX_SEGMENTS];
+    size_t numSegments;
+    size_t size;           // Image size in bytes.
+    size_t usedSize;       // Bytes used by segments.
+    Elf32_Addr imageBase;  // Virtual address of the image start.
+    size_t offset;         // Offset in the region, once placed.
+} CTRDLPackLayout;
+
+typedef struct CTRDLCodeRegion {
+    u32 origin;                   // Original address of the region.
+    u32 base;                     // Mirror address of the region, once committed.
+    size_t numPages;              // Size of the region in pages.
+    size_t numObjects;            // Objects placed in the region.
+    size_t usedSize;              // Bytes used by placed objects.
+    struct CTRDLCodeRegion* next; // Next region.
+    u8 pagePerms[];               // Permissions of each page, 0 if unused.
+} CTRDLCodeRegion;
+
+// Objects are packed so that each page only holds segments with the same permissions.
+// Layouts which could not be placed are left with CTRDL_PACK_NOT_PLACED; returns NULL if none was.
+// The following functions assume the handle mutex is held.
+CTRDLCodeRegion* ctrdl_packObjects(CTRDLPackLayout** layouts, size_t numLayouts);
+bool ctrdl_commitRegion(CTRDLCodeRegion* region);
+bool ctrdl_protectRegion(CTRDLCodeRegion* region, const CTRDLPackLayout* layout);
+
+// The region is freed along with the last object.
+bool ctrdl_releaseRegion(CTRDLCodeRegion* region, size_t size);
+void ctrdl_getCodeStats(CTRDLCodeStats* stats);
+
+#endif /* _CTRDL_CODEREGION_H */
@@ -27,20 +27,244 @@ Elf32_Word ctrdl_getELFSymNameHash(const char* name) {
     return h;
 }
 
-bool ctrdl_parseELF(CTRDLStream* stream, CTRDLElf* out) {
-    memset(out, 0, sizeof(CTRDLElf));
+Elf32_Word ctrdl_getELFSymNameGnuHash(const char* name) {
+    Elf32_Word h = 5381;
 
-    // Read header.
-    if (!stream->seek(stream, 0)) {
+    while (*name) {
+        h = (h << 5) + h + (u8)*name;
+        ++name;
+    }
+
+    return h;
+}
+
+static const Elf32_Sym* ctrdl_findELFSymGnu(const CTRDLSymTable* table, const CTRDLSymKey* key, const Elf32_Sym* skip) {
+    // Most misses are rejected by the Bloom filter.
+    const Elf32_Addr word = table->gnuBloom[(key->gnuHash / 32) & table->gnuBloomMask];
+    const Elf32_Word mask = (1u << (key->gnuHash % 32)) | (1u << ((key->gnuHash >> table->gnuBloomShift) % 32));
+    if ((word & mask) != mask)
+        return NULL;
+
+    Elf32_Word index = table->gnuBuckets[key->gnuHash % table->numGnuBuckets];
+    if (index < table->gnuSymOffset)
+        return NULL;
+
+    // Stored hashes are compared before names, the low bit marks the end of a chain.
+    for (; index < table->numSymEntries; ++index) {
+        const Elf32_Word hash = table->gnuChains[index - table->gnuSymOffset];
+        if ((hash | 1) == (key->gnuHash | 1)) {
+            const Elf32_Sym* sym = &table->symEntries[index];
+            if ((sym != skip) && ctrdl_matchELFSymName(table, sym, key))
+                return sym;
+        }
+
+        if (hash & 1)
+            break;
+    }
+
+    return NULL;
+}
+
+static const Elf32_Sym* ctrdl_findELFSymSysV(const CTRDLSymTable* table, CTRDLSymKey* key, const Elf32_Sym* skip) {
+    const Elf32_Word hash = ctrdl_getELFSymKeyHash(key);
+    Elf32_Word index = table->symBuckets[hash % table->numSymBuckets];
+
+    while ((index != STN_UNDEF) && (index < table->numSymEntries)) {
+        const Elf32_Sym* sym = &table->symEntries[index];
+        if ((sym != skip) && ctrdl_matchELFSymName(table, sym, key))
+            return sym;
+
+        index = table->symChains[index];
+    }
+
+    return NULL;
+}
+
+const Elf32_Sym* ctrdl_findELFSym(const CTRDLSymTable* table, CTRDLSymKey* key, const Elf32_Sym* skip) {
+    if (table->numGnuBuckets)
+        return ctrdl_findELFSymGnu(table, key, skip);
+
+    if (table->numSymBuckets)
+        return ctrdl_findELFSymSysV(table, key, skip);
+
+    return NULL;
+}
+
+// Tables are used in place when the stream is memory backed and the data is aligned.
+static void* ctrdl_mapELFData(CTRDLStream* stream, size_t offset, size_t size) {
+    void* p = (void*)ctrdl_streamMap(stream, offset, size);
+    if (p && !((uintptr_t)p & (sizeof(Elf32_Word) - 1)))
+        return p;
+
+    return NULL;
+}
+
+static bool ctrdl_readELFData(CTRDLStream* stream, size_t offset, void* out, size_t size) {
+    if (!ctrdl_streamSeek(stream, offset) || !ctrdl_streamRead(stream, out, size)) {
         ctrdl_setLastError(Err_ReadFailed);
         return false;
     }
 
-    if (!stream->read(stream, &out->header, sizeof(Elf32_Ehdr))) {
-        ctrdl_setLastError(Err_ReadFailed);
+    return true;
+}
+
+static bool ctrdl_getELFTableOffset(CTRDLElf* elf, Elf32_Addr addr, size_t size, size_t* out) {
+    // The whole table must be backed by the file.
+    size_t endOffset;
+    if (!ctrdl_getELFOffsetForAddr(elf, addr, out) || (size && !ctrdl_getELFOffsetForAddr(elf, addr + size - 1, &endOffset))) {
+        ctrdl_setLastError(Err_InvalidObject);
         return false;
     }
 
+    return true;
+}
+
+static int ctrdl_getELFDynSlot(Elf32_Sword tag) {
+    if ((tag >= 0) && (tag < CTRDL_DYN_NUM_STD_SLOTS))
+        return tag;
+
+    if (tag == DT_GNU_HASH)
+        return CTRDL_DYN_SLOT_GNU_HASH;
+
+    return -1;
+}
+
+static void ctrdl_indexELFDyn(CTRDLElf* elf) {
+    memset(elf->dynSlots, 0, sizeof(elf->dynSlots));
+
+    // Entries past DT_NULL are ignored.
+    for (size_t i = 0; i < elf->numDynEntries; ++i) {
+        const Elf32_Sword tag = elf->dynEntries[i].d_tag;
+        if (tag == DT_NULL) {
+            elf->numDynEntries = i;
+            break;
+        }
+
+        const int slotIndex = ctrdl_getELFDynSlot(tag);
+        if (slotIndex < 0)
+            continue;
+
+        CTRDLDynSlot* slot = &elf->dynSlots[slotIndex];
+        if (!slot->count)
+            slot->first = i;
+
+        slot->last = i;
+        ++slot->count;
+    }
+}
+
+static bool ctrdl_parseELFRelocs(CTRDLElf* out) {
+    // Relocation tables are read from the mapped image.
+    Elf32_Dyn jmpRelArray;
+    Elf32_Dyn jmpRelSize;
+    Elf32_Dyn jmpRelType;
+    const bool hasJmpRelArray = ctrdl_getELFDynEntryWithTag(out, DT_JMPREL, &jmpRelArray);
+    const bool hasJmpRelSize = ctrdl_getELFDynEntryWithTag(out, DT_PLTRELSZ, &jmpRelSize);
+    const bool hasJmpRelType = ctrdl_getELFDynEntryWithTag(out, DT_PLTREL, &jmpRelType);
+    const bool hasJmpRel = hasJmpRelArray && hasJmpRelSize && hasJmpRelType;
+    size_t offset;
+
+    if (hasJmpRel) {
+        switch (jmpRelType.d_un.d_val) {
+            case DT_REL:
+                out->jmpRelArraySize = jmpRelSize.d_un.d_val / sizeof(Elf32_Rel);
+                break;
+            case DT_RELA:
+                out->jmpRelArraySize = jmpRelSize.d_un.d_val / sizeof(Elf32_Rela);
+                break;
+            default:
+                ctrdl_setLastError(Err_InvalidObject);
+                return false;
+        }
+
+        out->jmpRelAddr = jmpRelArray.d_un.d_ptr;
+        out->jmpRelType = jmpRelType.d_un.d_val;
+        if (!ctrdl_getELFTableOffset(out, out->jmpRelAddr, jmpRelSize.d_un.d_val, &offset))
+            return false;
+
+        // GOT[0..2] are reserved for the loader.
+        Elf32_Dyn pltGot;
+        if (ctrdl_getELFDynEntryWithTag(out, DT_PLTGOT, &pltGot) && !(pltGot.d_un.d_ptr & (sizeof(Elf32_Addr) - 1)))
+            out->pltGotAddr = pltGot.d_un.d_ptr;
+    }
+
+    Elf32_Dyn relArray;
+    Elf32_Dyn relSize;
+    Elf32_Dyn relEnt;
+    const bool hasRelArray = ctrdl_getELFDynEntryWithTag(out, DT_REL, &relArray);
+    const bool hasRelSize = ctrdl_getELFDynEntryWithTag(out, DT_RELSZ, &relSize);
+    const bool hasRelEnt = ctrdl_getELFDynEntryWithTag(out, DT_RELENT, &relEnt);
+
+    if (hasRelArray && hasRelSize && hasRelEnt) {
+        if (relEnt.d_un.d_val != sizeof(Elf32_Rel)) {
+            ctrdl_setLastError(Err_InvalidObject);
+            return false;
+        }
+
+        out->relAddr = relArray.d_un.d_ptr;
+        out->relArraySize = relSize.d_un.d_val / sizeof(Elf32_Rel);
+        if (!ctrdl_getELFTableOffset(out, out->relAddr, relSize.d_un.d_val, &offset))
+            return false;
+
+        Elf32_Dyn relCount;
+        if (ctrdl_getELFDynEntryWithTag(out, DT_RELCOUNT, &relCount) && (relCount.d_un.d_val <= out->relArraySize))
+            out->relCount = relCount.d_un.d_val;
+    }
+
+    Elf32_Dyn relaArray;
+    Elf32_Dyn relaSize;
+    Elf32_Dyn relaEnt;
+    const bool hasRelaArray = ctrdl_getELFDynEntryWithTag(out, DT_RELA, &relaArray);
+    const bool hasRelaSize = ctrdl_getELFDynEntryWithTag(out, DT_RELASZ, &relaSize);
+    const bool hasRelaEnt = ctrdl_getELFDynEntryWithTag(out, DT_RELAENT, &relaEnt);
+
+    if (hasRelaArray && hasRelaSize && hasRelaEnt) {
+        if (relaEnt.d_un.d_val != sizeof(Elf32_Rela)) {
+            ctrdl_setLastError(Err_InvalidObject);
+            return false;
+        }
+
+        out->relaAddr = relaArray.d_un.d_ptr;
+        out->relaArraySize = relaSize.d_un.d_val / sizeof(Elf32_Rela);
+        if (!ctrdl_getELFTableOffset(out, out->relaAddr, relaSize.d_un.d_val, &offset))
+            return false;
+
+        Elf32_Dyn relaCount;
+        if (ctrdl_getELFDynEntryWithTag(out, DT_RELACOUNT, &relaCount) && (relaCount.d_un.d_val <= out->relaArraySize))
+            out->relaCount = relaCount.d_un.d_val;
+    }
+
+    Elf32_Dyn relrArray;
+    Elf32_Dyn relrSize;
+    Elf32_Dyn relrEnt;
+    const bool hasRelrArray = ctrdl_getELFDynEntryWithTag(out, DT_RELR, &relrArray);
+    const bool hasRelrSize = ctrdl_getELFDynEntryWithTag(out, DT_RELRSZ, &relrSize);
+    const bool hasRelrEnt = ctrdl_getELFDynEntryWithTag(out, DT_RELRENT, &relrEnt);
+
+    if (hasRelrArray && hasRelrSize && hasRelrEnt) {
+        if ((relrEnt.d_un.d_val != sizeof(Elf32_Word)) || (relrArray.d_un.d_ptr & (sizeof(Elf32_Word) - 1))) {
+            ctrdl_setLastError(Err_InvalidObject);
+            return false;
+        }
+
+        out->relrAddr = relrArray.d_un.d_ptr;
+        out->relrArraySize = relrSize.d_un.d_val / sizeof(Elf32_Word);
+        if (!ctrdl_getELFTableOffset(out, out->relrAddr, relrSize.d_un.d_val, &offset))
+            return false;
+    }
+
+    return true;
+}
+
+bool ctrdl_parseELF(CTRDLStream* stream, CTRDLElf* out) {
+    memset(out, 0, sizeof(CTRDLElf));
+    out->mapBase = ctrdl_streamMap(stream, 0, stream->size);
+    out->mapSize = out->mapBase ? stream->size : 0;
+
+    // Read header.
+    if (!ctrdl_readELFData(stream, 0, &out->header, sizeof(Elf32_Ehdr)))
+        return false;
+
     if (memcmp(out->header.e_ident, ELFMAG, SELFMAG)) {
         ctrdl_setLastError(Err_InvalidObject);
         return false;
@@ -67,301 +291,292 @@ bool ctrdl_parseELF(CTRDLStream* stream, CTRDLElf* out) {
     }
 
     // Read program headers.
-    if (!stream->seek(stream, out->header.e_phoff)) {
-        ctrdl_setLastError(Err_ReadFailed);
-        return false;
-    }
-
-    out->segments = malloc(out->header.e_phnum * sizeof(Elf32_Phdr));
+    const size_t segmentsSize = out->header.e_phnum * sizeof(Elf32_Phdr);
+    out->segments = ctrdl_mapELFData(stream, out->header.e_phoff, segmentsSize);
     if (!out->segments) {
-        ctrdl_setLastError(Err_NoMemory);
-        return false;
-    }
-
-    for (size_t i = 0; i < out->header.e_phnum; ++i) {
-        if (!stream->read(stream, &out->segments[i], sizeof(Elf32_Phdr))) {
-            ctrdl_setLastError(Err_ReadFailed);
-            ctrdl_freeELF(out);
+        if (out->header.e_phnum > CTRDL_MAX_SEGMENTS) {
+            ctrdl_setLastError(Err_InvalidObject);
             return false;
         }
+
+        out->segments = out->segmentStorage;
+        if (!ctrdl_readELFData(stream, out->header.e_phoff, out->segments, segmentsSize))
+            return false;
     }
 
-    // Read dyn entries.
+    // Read dyn entries, this is the only transient allocation.
     Elf32_Phdr dyn;
-    if (!ctrdl_getELFSegmentByType(out, PT_DYNAMIC, &dyn)) {
+    if (!ctrdl_getELFSegmentByType(out, PT_DYNAMIC, &dyn) || (dyn.p_filesz < sizeof(Elf32_Dyn))) {
         ctrdl_setLastError(Err_InvalidObject);
-        ctrdl_freeELF(out);
         return false;
     }
 
-    if (!stream->seek(stream, dyn.p_offset)) {
-        ctrdl_setLastError(Err_InvalidObject);
-        ctrdl_freeELF(out);
-        return false;
-    }
-
-    out->dynEntries = malloc(dyn.p_filesz);
+    out->dynEntries = ctrdl_mapELFData(stream, dyn.p_offset, dyn.p_filesz);
     if (!out->dynEntries) {
-        ctrdl_setLastError(Err_NoMemory);
-        ctrdl_freeELF(out);
-        return false;
+        out->dynEntries = malloc(dyn.p_filesz);
+        if (!out->dynEntries) {
+            ctrdl_setLastError(Err_NoMemory);
+            return false;
+        }
+
+        ++out->numAllocs;
+        if (!ctrdl_readELFData(stream, dyn.p_offset, out->dynEntries, dyn.p_filesz)) {
+            ctrdl_freeELF(out);
+            return false;
+        }
     }
 
-    if (!stream->read(stream, out->dynEntries, dyn.p_filesz)) {
+    out->numDynEntries = dyn.p_filesz / sizeof(Elf32_Dyn);
+    if (out->numDynEntries > UINT16_MAX) {
         ctrdl_setLastError(Err_InvalidObject);
         ctrdl_freeELF(out);
         return false;
     }
 
-    // Read sym hash table.
+    ctrdl_indexELFDyn(out);
+
+    // Locate tables, these are accessed through the mapped image.
     Elf32_Dyn hash;
-    if (!ctrdl_getELFDynEntryWithTag(out, DT_HASH, &hash)) {
+    Elf32_Dyn gnuHash;
+    Elf32_Dyn symtab;
+    Elf32_Dyn strtab;
+    Elf32_Dyn strsz;
+    const bool hasHash = ctrdl_getELFDynEntryWithTag(out, DT_HASH, &hash);
+    const bool hasGnuHash = ctrdl_getELFDynEntryWithTag(out, DT_GNU_HASH, &gnuHash);
+
+    if ((!hasHash && !hasGnuHash) || !ctrdl_getELFDynEntryWithTag(out, DT_SYMTAB, &symtab) ||
+        !ctrdl_getELFDynEntryWithTag(out, DT_STRTAB, &strtab) || !ctrdl_getELFDynEntryWithTag(out, DT_STRSZ, &strsz)) {
         ctrdl_setLastError(Err_InvalidObject);
         ctrdl_freeELF(out);
         return false;
     }
 
-    if (!stream->seek(stream, hash.d_un.d_ptr)) {
-        ctrdl_setLastError(Err_ReadFailed);
-        ctrdl_freeELF(out);
-        return false;
-    }
+    out->hashAddr = hasHash ? hash.d_un.d_ptr : 0;
+    out->gnuHashAddr = hasGnuHash ? gnuHash.d_un.d_ptr : 0;
+    out->symtabAddr = symtab.d_un.d_ptr;
+    out->strtabAddr = strtab.d_un.d_ptr;
+    out->strtabSize = strsz.d_un.d_val;
 
-    if (!stream->read(stream, &out->numSymBuckets, sizeof(Elf32_Word))) {
-        ctrdl_setLastError(Err_ReadFailed);
+    size_t offset;
+    if ((hasHash && !ctrdl_getELFTableOffset(out, out->hashAddr, 2 * sizeof(Elf32_Word), &offset)) ||
+        (hasGnuHash && !ctrdl_getELFTableOffset(out, out->gnuHashAddr, 4 * sizeof(Elf32_Word), &offset)) ||
+        !ctrdl_getELFTableOffset(out, out->strtabAddr, out->strtabSize, &offset)) {
         ctrdl_freeELF(out);
         return false;
     }
 
-    if (!stream->read(stream, &out->numSymChains, sizeof(Elf32_Word))) {
-        ctrdl_setLastError(Err_ReadFailed);
+    if (!ctrdl_parseELFRelocs(out)) {
         ctrdl_freeELF(out);
         return false;
     }
 
-    out->symBuckets = malloc(out->numSymBuckets * sizeof(Elf32_Word));
-    if (!out->symBuckets) {
-        ctrdl_setLastError(Err_NoMemory);
-        ctrdl_freeELF(out);
-        return false;
-    }
+    return true;
+}
 
-    out->symChains = malloc(out->numSymChains * sizeof(Elf32_Word));
-    if (!out->symChains) {
-        ctrdl_setLastError(Err_NoMemory);
-        ctrdl_freeELF(out);
-        return false;
-    }
+void ctrdl_freeELF(CTRDLElf* elf) {
+    if (!ctrdl_isELFDataInPlace(elf, elf->dynEntries))
+        free(elf->dynEntries);
 
-    if (!stream->read(stream, out->symBuckets, out->numSymBuckets * sizeof(Elf32_Word))) {
-        ctrdl_setLastError(Err_ReadFailed);
-        ctrdl_freeELF(out);
-        return false;
-    }
+    elf->dynEntries = NULL;
+}
 
-    if (!stream->read(stream, out->symChains, out->numSymChains * sizeof(Elf32_Word))) {
-        ctrdl_setLastError(Err_ReadFailed);
-        ctrdl_freeELF(out);
-        return false;
+size_t ctrdl_getELFAllocAlign(CTRDLStream* stream, const CTRDLElf* elf) {
+    const Elf32_Ehdr* header = &elf->header;
+    if (!header->e_shnum || (header->e_shentsize != sizeof(Elf32_Shdr)))
+        return 0;
+
+    // Section headers are optional, failures are not errors.
+    const size_t size = header->e_shnum * sizeof(Elf32_Shdr);
+    const Elf32_Shdr* sections = ctrdl_streamMap(stream, header->e_shoff, size);
+    Elf32_Shdr storage[8];
+    size_t align = 1;
+
+    for (size_t i = 0; i < header->e_shnum; ++i) {
+        const Elf32_Shdr* section = sections ? &sections[i] : &storage[i % 8];
+        if (!sections && !(i % 8)) {
+            const size_t count = ((header->e_shnum - i) < 8) ? (header->e_shnum - i) : 8;
+            if (!ctrdl_streamSeek(stream, header->e_shoff + i * sizeof(Elf32_Shdr)) || !ctrdl_streamRead(stream, storage, count * sizeof(Elf32_Shdr)))
+                return 0;
+        }
+
+        if ((section->sh_flags & SHF_ALLOC) && (section->sh_addralign > align))
+            align = section->sh_addralign;
     }
 
-    // Read sym entries.
-    Elf32_Dyn symtab;
-    if (!ctrdl_getELFDynEntryWithTag(out, DT_SYMTAB, &symtab)) {
+    return align;
+}
+
+char* ctrdl_readELFString(CTRDLStream* stream, CTRDLElf* elf, Elf32_Word offset) {
+    size_t fileOffset;
+    if ((offset >= elf->strtabSize) || !ctrdl_getELFOffsetForAddr(elf, elf->strtabAddr + offset, &fileOffset)) {
         ctrdl_setLastError(Err_InvalidObject);
-        ctrdl_freeELF(out);
-        return false;
+        return NULL;
     }
 
-    if (!stream->seek(stream, symtab.d_un.d_ptr)) {
-        ctrdl_setLastError(Err_ReadFailed);
-        ctrdl_freeELF(out);
-        return false;
-    }
+    // Names are short, read them in small chunks.
+    const size_t maxSize = elf->strtabSize - offset;
+    char* buffer = NULL;
+    size_t size = 0;
 
-    out->symEntries = malloc(out->numSymChains * sizeof(Elf32_Sym));
-    if (!out->symEntries) {
-        ctrdl_setLastError(Err_NoMemory);
-        ctrdl_freeELF(out);
-        return false;
-    }
+    while (size < maxSize) {
+        const size_t chunkSize = ((maxSize - size) < 32) ? (maxSize - size) : 32;
+        char* p = realloc(buffer, size + chunkSize);
+        if (!p) {
+            free(buffer);
+            ctrdl_setLastError(Err_NoMemory);
+            return NULL;
+        }
 
-    if (!stream->read(stream, out->symEntries, out->numSymChains * sizeof(Elf32_Sym))) {
-        ctrdl_setLastError(Err_ReadFailed);
-        ctrdl_freeELF(out);
-        return false;
-    }
+        buffer = p;
+        if (!ctrdl_readELFData(stream, fileOffset + size, &buffer[size], chunkSize)) {
+            free(buffer);
+            return NULL;
+        }
 
-    // Read string table.
-    Elf32_Dyn strtab;
-    if (!ctrdl_getELFDynEntryWithTag(out, DT_STRTAB, &strtab)) {
-        ctrdl_setLastError(Err_InvalidObject);
-        ctrdl_freeELF(out);
-        return false;
+        const bool terminated = memchr(&buffer[size], '\0', chunkSize) != NULL;
+        size += chunkSize;
+        if (terminated)
+            return buffer;
     }
 
-    if (!stream->seek(stream, strtab.d_un.d_ptr)) {
-        ctrdl_setLastError(Err_ReadFailed);
-        ctrdl_freeELF(out);
-        return false;
-    }
+    free(buffer);
+    ctrdl_setLastError(Err_InvalidObject);
+    return NULL;
+}
 
-    Elf32_Dyn strsz;
-    if (!ctrdl_getELFDynEntryWithTag(out, DT_STRSZ, &strsz)) {
+static bool ctrdl_bindELFGnuHash(CTRDLElf* elf, u32 imageBase) {
+    CTRDLSymTable* table = &elf->symTable;
+    const Elf32_Word* header = (const Elf32_Word*)(imageBase + elf->gnuHashAddr);
+    const Elf32_Word numBuckets = header[0];
+    const Elf32_Word symOffset = header[1];
+    const Elf32_Word bloomSize = header[2];
+    const Elf32_Word bloomShift = header[3];
+
+    // The Bloom filter is indexed by mask.
+    if (!numBuckets || !bloomSize || (bloomSize & (bloomSize - 1))) {
         ctrdl_setLastError(Err_InvalidObject);
-        ctrdl_freeELF(out);
         return false;
     }
 
-    out->stringTable = malloc(strsz.d_un.d_val);
-    if (!out->stringTable) {
-        ctrdl_setLastError(Err_NoMemory);
-        ctrdl_freeELF(out);
+    const Elf32_Addr chainsAddr = elf->gnuHashAddr + (4 + bloomSize + numBuckets) * sizeof(Elf32_Word);
+    size_t offset;
+    if (!ctrdl_getELFTableOffset(elf, elf->gnuHashAddr, chainsAddr - elf->gnuHashAddr, &offset))
         return false;
-    }
 
-    if (!stream->read(stream, out->stringTable, strsz.d_un.d_val)) {
-        ctrdl_setLastError(Err_ReadFailed);
-        ctrdl_freeELF(out);
-        return false;
+    const Elf32_Addr* bloom = (const Elf32_Addr*)(header + 4);
+    const Elf32_Word* buckets = (const Elf32_Word*)(bloom + bloomSize);
+    const Elf32_Word* chains = (const Elf32_Word*)(imageBase + chainsAddr);
+
+    // The number of symbols is not stored, walk the chain starting from the highest bucket.
+    Elf32_Word numSymEntries = symOffset;
+    Elf32_Word lastIndex = 0;
+    for (size_t i = 0; i < numBuckets; ++i) {
+        if (buckets[i] > lastIndex)
+            lastIndex = buckets[i];
     }
 
-    // Read reloc info.
-    Elf32_Dyn jmpRelArray;
-    Elf32_Dyn jmpRelSize;
-    Elf32_Dyn jmpRelType;
-    const bool hasJmpRelArray = ctrdl_getELFDynEntryWithTag(out, DT_JMPREL, &jmpRelArray);
-    const bool hasJmpRelSize = ctrdl_getELFDynEntryWithTag(out, DT_PLTRELSZ, &jmpRelSize);
-    const bool hasJmpRelType = ctrdl_getELFDynEntryWithTag(out, DT_PLTREL, &jmpRelType);
-    const bool hasJmpRel = hasJmpRelArray && hasJmpRelSize && hasJmpRelType;
+    if (lastIndex >= symOffset) {
+        for (;;) {
+            if (!ctrdl_getELFTableOffset(elf, chainsAddr + (lastIndex - symOffset) * sizeof(Elf32_Word), sizeof(Elf32_Word), &offset))
+                return false;
 
-    size_t numActuallyJmpRel = 0;
-    if (hasJmpRel) {
-        switch (jmpRelType.d_un.d_val) {
-            case DT_REL:
-                numActuallyJmpRel = jmpRelSize.d_un.d_val / sizeof(Elf32_Rel);
-                out->relArraySize = numActuallyJmpRel;
-                out->relaArraySize = 0;
+            if (chains[lastIndex - symOffset] & 1)
                 break;
-            case DT_RELA:
-                numActuallyJmpRel = jmpRelSize.d_un.d_val / sizeof(Elf32_Rela);
-                out->relArraySize = 0;
-                out->relaArraySize = numActuallyJmpRel;
-                break;
-            default:
-                ctrdl_setLastError(Err_InvalidObject);
-                ctrdl_freeELF(out);
-                return false;
-        }
-    }
 
-    Elf32_Dyn relArray;
-    Elf32_Dyn relSize;
-    Elf32_Dyn relEnt;
-    const bool hasRelArray = ctrdl_getELFDynEntryWithTag(out, DT_REL, &relArray);
-    const bool hasRelSize = ctrdl_getELFDynEntryWithTag(out, DT_RELSZ, &relSize);
-    const bool hasRelEnt = ctrdl_getELFDynEntryWithTag(out, DT_RELENT, &relEnt);
-    const bool hasRel = hasRelArray && hasRelSize && hasRelEnt;
+            ++lastIndex;
+        }
 
-    size_t numActuallyRel = 0;
-    if (hasRel) {
-        numActuallyRel = (relSize.d_un.d_val / relEnt.d_un.d_val);
-        out->relArraySize += numActuallyRel;
+        numSymEntries = lastIndex + 1;
     }
 
-    if (out->relArraySize) {
-        out->relArray = malloc(out->relArraySize * sizeof(Elf32_Rel));
-        if (!out->relArray) {
-            ctrdl_setLastError(Err_NoMemory);
-            ctrdl_freeELF(out);
-            return false;
-        }
+    table->numGnuBuckets = numBuckets;
+    table->gnuSymOffset = symOffset;
+    table->gnuBloomMask = bloomSize - 1;
+    table->gnuBloomShift = bloomShift;
+    table->gnuBloom = bloom;
+    table->gnuBuckets = buckets;
+    table->gnuChains = chains;
+    table->numSymEntries = numSymEntries;
+    return true;
+}
 
-        if (!stream->seek(stream, relArray.d_un.d_ptr)) {
-            ctrdl_setLastError(Err_ReadFailed);
-            ctrdl_freeELF(out);
-            return false;
-        }
+static bool ctrdl_bindELFHash(CTRDLElf* elf, u32 imageBase) {
+    CTRDLSymTable* table = &elf->symTable;
+    const Elf32_Word* hash = (const Elf32_Word*)(imageBase + elf->hashAddr);
+    const Elf32_Word numBuckets = hash[0];
+    const Elf32_Word numChains = hash[1];
 
-        if (!stream->read(stream, out->relArray, numActuallyRel * sizeof(Elf32_Rel))) {
-            ctrdl_setLastError(Err_ReadFailed);
-            ctrdl_freeELF(out);
-            return false;
-        }
+    size_t offset;
+    if (!numBuckets || !ctrdl_getELFTableOffset(elf, elf->hashAddr, (2 + numBuckets + numChains) * sizeof(Elf32_Word), &offset)) {
+        ctrdl_setLastError(Err_InvalidObject);
+        return false;
     }
 
-    Elf32_Dyn relaArray;
-    Elf32_Dyn relaSize;
-    Elf32_Dyn relaEnt;
-    const bool hasRelaArray = ctrdl_getELFDynEntryWithTag(out, DT_RELA, &relaArray);
-    const bool hasRelaSize = ctrdl_getELFDynEntryWithTag(out, DT_RELASZ, &relaSize);
-    const bool hasRelaEnt = ctrdl_getELFDynEntryWithTag(out, DT_RELAENT, &relaEnt);
-    const bool hasRela = hasRelaArray && hasRelaSize && hasRelaEnt;
+    table->numSymBuckets = numBuckets;
+    table->symBuckets = hash + 2;
+    table->symChains = table->symBuckets + numBuckets;
+    table->numSymEntries = numChains;
+    return true;
+}
 
-    size_t numActuallyRela = 0;
-    if (hasRela) {
-        numActuallyRela = (relaSize.d_un.d_val / relaEnt.d_un.d_val);
-        out->relaArraySize += numActuallyRela;
-    }
+bool ctrdl_bindELFTables(CTRDLElf* elf, u32 imageBase) {
+    CTRDLSymTable* table = &elf->symTable;
+    memset(table, 0, sizeof(CTRDLSymTable));
 
-    if (out->relaArraySize) {
-        out->relaArray = malloc(out->relaArraySize * sizeof(Elf32_Rela));
-        if (!out->relaArray) {
-            ctrdl_setLastError(Err_NoMemory);
-            ctrdl_freeELF(out);
+    // Sizes are only known now, make sure the tables are part of the image.
+    if (elf->gnuHashAddr) {
+        if (!ctrdl_bindELFGnuHash(elf, imageBase))
             return false;
-        }
+    } else if (!ctrdl_bindELFHash(elf, imageBase)) {
+        return false;
+    }
 
-        if (!stream->seek(stream, relaArray.d_un.d_ptr)) {
-            ctrdl_setLastError(Err_ReadFailed);
-            ctrdl_freeELF(out);
-            return false;
-        }
+    size_t offset;
+    if (!ctrdl_getELFTableOffset(elf, elf->symtabAddr, table->numSymEntries * sizeof(Elf32_Sym), &offset))
+        return false;
 
-        if (!stream->read(stream, out->relaArray, numActuallyRela * sizeof(Elf32_Rela))) {
-            ctrdl_setLastError(Err_ReadFailed);
-            ctrdl_freeELF(out);
-            return false;
-        }
-    }
+    table->symEntries = (const Elf32_Sym*)(imageBase + elf->symtabAddr);
+    table->stringTable = (const char*)(imageBase + elf->strtabAddr);
+    table->stringTableSize = elf->strtabSize;
+    return true;
+}
 
-    if (hasJmpRel) {
-        void* dst = NULL;
-        size_t toRead = 0;
-
-        if (jmpRelType.d_un.d_val == DT_REL) {
-            dst = out->relArray + numActuallyRel;
-            toRead = numActuallyJmpRel * sizeof(Elf32_Rel);
-        } else {
-            dst = out->relaArray + numActuallyRela;
-            toRead = numActuallyJmpRel * sizeof(Elf32_Rela);
-        }
+static inline void ctrdl_growELFTablesEnd(Elf32_Addr* end, Elf32_Addr addr, size_t size) {
+    if (size && ((addr + size) > *end))
+        *end = addr + size;
+}
 
-        if (!stream->seek(stream, jmpRelArray.d_un.d_ptr)) {
-            ctrdl_setLastError(Err_ReadFailed);
-            ctrdl_freeELF(out);
-            return false;
-        }
+Elf32_Addr ctrdl_getELFTablesEnd(const CTRDLElf* elf) {
+    const CTRDLSymTable* table = &elf->symTable;
+    Elf32_Addr end = 0;
+
+    if (elf->gnuHashAddr) {
+        const size_t numHeaderWords = 4 + (table->gnuBloomMask + 1) + table->numGnuBuckets;
+        const size_t numChains = table->numSymEntries > table->gnuSymOffset ? table->numSymEntries - table->gnuSymOffset : 0;
+        ctrdl_growELFTablesEnd(&end, elf->gnuHashAddr, (numHeaderWords + numChains) * sizeof(Elf32_Word));
+    } else {
+        ctrdl_growELFTablesEnd(&end, elf->hashAddr, (2 + table->numSymBuckets + table->numSymEntries) * sizeof(Elf32_Word));
+    }
+
+    ctrdl_growELFTablesEnd(&end, elf->symtabAddr, table->numSymEntries * sizeof(Elf32_Sym));
+    ctrdl_growELFTablesEnd(&end, elf->strtabAddr, elf->strtabSize);
+    ctrdl_growELFTablesEnd(&end, elf->relAddr, elf->relArraySize * sizeof(Elf32_Rel));
+    ctrdl_growELFTablesEnd(&end, elf->relaAddr, elf->relaArraySize * sizeof(Elf32_Rela));
+    ctrdl_growELFTablesEnd(&end, elf->relrAddr, elf->relrArraySize * sizeof(Elf32_Word));
+    ctrdl_growELFTablesEnd(&end, elf->jmpRelAddr, elf->jmpRelArraySize * ((elf->jmpRelType == DT_REL) ? sizeof(Elf32_Rel) : sizeof(Elf32_Rela)));
+    return end;
+}
 
-        if (!stream->read(stream, dst, toRead)) {
-            ctrdl_setLastError(Err_ReadFailed);
-            ctrdl_freeELF(out);
-            return false;
+bool ctrdl_getELFOffsetForAddr(CTRDLElf* elf, Elf32_Addr addr, size_t* out) {
+    for (size_t i = 0; i < elf->header.e_phnum; ++i) {
+        const Elf32_Phdr* ph = &elf->segments[i];
+        if ((ph->p_type == PT_LOAD) && (addr >= ph->p_vaddr) && (addr < (ph->p_vaddr + ph->p_filesz))) {
+            *out = ph->p_offset + (addr - ph->p_vaddr);
+            return true;
         }
     }
 
-    return true;
-}
-
-void ctrdl_freeELF(CTRDLElf* elf) {
-    free(elf->segments);
-    free(elf->dynEntries);
-    free(elf->symBuckets);
-    free(elf->symChains);
-    free(elf->symEntries);
-    free(elf->stringTable);
-    free(elf->relArray);
-    free(elf->relaArray);
+    return false;
 }
 
 size_t ctrdl_getELFNumSegmentsByType(CTRDLElf* elf, Elf32_Word type) {
@@ -394,32 +609,43 @@ size_t ctrdl_getELFSegmentsByType(CTRDLElf* elf, Elf32_Word type, Elf32_Phdr* ou
 }
 
 size_t ctrdl_getELFNumDynEntriesWithTag(CTRDLElf* elf, Elf32_Sword tag) {
-    size_t count = 0;
-    Elf32_Dyn* entry = elf->dynEntries;
+    const int slotIndex = ctrdl_getELFDynSlot(tag);
+    if (slotIndex >= 0)
+        return elf->dynSlots[slotIndex].count;
 
-    while (entry->d_tag != DT_NULL) {
-        if (entry->d_tag == tag) {
+    // Unindexed tags.
+    size_t count = 0;
+    for (size_t i = 0; i < elf->numDynEntries; ++i) {
+        if (elf->dynEntries[i].d_tag == tag)
             ++count;
-        }
-
-        ++entry;
     }
 
     return count;
 }
 
 size_t ctrdl_getELFDynEntriesWithTag(CTRDLElf* elf, Elf32_Sword tag, Elf32_Dyn* out, size_t maxSize) {
-    size_t count = 0;
-    Elf32_Dyn* entry = elf->dynEntries;
+    size_t begin = 0;
+    size_t end = elf->numDynEntries;
 
-    while (entry->d_tag != DT_NULL) {
+    // Repeated tags, such as DT_NEEDED, are usually contiguous.
+    const int slotIndex = ctrdl_getELFDynSlot(tag);
+    if (slotIndex >= 0) {
+        const CTRDLDynSlot* slot = &elf->dynSlots[slotIndex];
+        if (!slot->count)
+            return 0;
+
+        begin = slot->first;
+        end = slot->last + 1;
+    }
+
+    size_t count = 0;
+    for (size_t i = begin; (i < end) && (count < maxSize); ++i) {
+        const Elf32_Dyn* entry = &elf->dynEntries[i];
         if (entry->d_tag == tag) {
             memcpy(&out[count], entry, sizeof(Elf32_Dyn));
             ++count;
         }
-
-        ++entry;
     }
 
     return count;
-}
\ No newline at end of file
+}
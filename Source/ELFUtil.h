@@ -13,25 +13,150 @@
 #include <elf.h>
 #include <string.h>
 
+#ifndef DT_GNU_HASH
+#define DT_GNU_HASH 0x6FFFFEF5
+#endif // DT_GNU_HASH
+
+#ifndef DT_RELR
+#define DT_RELRSZ 35
+#define DT_RELR 36
+#define DT_RELRENT 37
+#endif // DT_RELR
+
+#ifndef DT_RELACOUNT
+#define DT_RELACOUNT 0x6FFFFFF9
+#endif // DT_RELACOUNT
+
+#ifndef DT_RELCOUNT
+#define DT_RELCOUNT 0x6FFFFFFA
+#endif // DT_RELCOUNT
+
+#define CTRDL_MAX_SEGMENTS 32
+#define CTRDL_SYM_HASH_NONE CTRDL_ELF_HASH_NONE
+
+// Standard tags are indexed directly, a few OS specific ones follow.
+#define CTRDL_DYN_NUM_STD_SLOTS 38
+#define CTRDL_DYN_SLOT_GNU_HASH CTRDL_DYN_NUM_STD_SLOTS
+#define CTRDL_DYN_NUM_SLOTS (CTRDL_DYN_NUM_STD_SLOTS + 1)
+
+typedef struct {
+    u16 first; // Index of the first entry with the tag.
+    u16 last;  // Index of the last entry with the tag.
+    u16 count; // Number of entries with the tag.
+} CTRDLDynSlot;
+
 typedef struct {
+    Elf32_Word numSymBuckets;        // Number of SysV hash buckets.
+    const Elf32_Word* symBuckets;    // SysV hash buckets.
+    const Elf32_Word* symChains;     // SysV hash chains.
+    Elf32_Word numGnuBuckets;        // Number of GNU hash buckets.
+    Elf32_Word gnuSymOffset;         // Index of the first GNU hashed symbol.
+    Elf32_Word gnuBloomMask;         // Number of GNU Bloom filter words, minus one.
+    Elf32_Word gnuBloomShift;        // Shift for the second Bloom filter bit.
+    const Elf32_Addr* gnuBloom;      // GNU Bloom filter.
+    const Elf32_Word* gnuBuckets;    // GNU hash buckets.
+    const Elf32_Word* gnuChains;     // GNU hash values, starting at gnuSymOffset.
+    Elf32_Word numSymEntries;        // Number of symbol entries.
+    const Elf32_Sym* symEntries;     // Symbol entries.
+    const char* stringTable;         // String table.
+    Elf32_Word stringTableSize;      // String table size.
+} CTRDLSymTable;
+
+typedef struct {
+    const char* name;
+    size_t len;         // Name length.
+    Elf32_Word hash;    // SysV hash, or CTRDL_SYM_HASH_NONE if not computed yet.
+    Elf32_Word gnuHash; // GNU hash.
+} CTRDLSymKey;
+
+typedef struct {
+    const u8* mapBase;
+    size_t mapSize;
+    size_t numAllocs;
     Elf32_Ehdr header;
     Elf32_Phdr* segments;
+    Elf32_Phdr segmentStorage[CTRDL_MAX_SEGMENTS];
     Elf32_Dyn* dynEntries;
-    Elf32_Word numSymBuckets;
-    Elf32_Word* symBuckets;
-    Elf32_Word numSymChains;
-    Elf32_Word* symChains;
-    Elf32_Sym* symEntries;
-    char* stringTable;
-    Elf32_Rel* relArray;
+    size_t numDynEntries;
+    CTRDLDynSlot dynSlots[CTRDL_DYN_NUM_SLOTS];
+    Elf32_Addr hashAddr;
+    Elf32_Addr gnuHashAddr;
+    Elf32_Addr symtabAddr;
+    Elf32_Addr strtabAddr;
+    size_t strtabSize;
+    CTRDLSymTable symTable;
+    Elf32_Addr relAddr;
     size_t relArraySize;
-    Elf32_Rela* relaArray;
+    size_t relCount;
+    Elf32_Addr relaAddr;
     size_t relaArraySize;
+    size_t relaCount;
+    Elf32_Addr relrAddr;
+    size_t relrArraySize;
+    Elf32_Addr pltGotAddr;
+    Elf32_Addr jmpRelAddr;
+    size_t jmpRelArraySize;
+    Elf32_Sword jmpRelType;
 } CTRDLElf;
 
 Elf32_Word ctrdl_getELFSymNameHash(const char* name);
+Elf32_Word ctrdl_getELFSymNameGnuHash(const char* name);
+
+static inline void ctrdl_makeELFSymKey(CTRDLSymKey* key, const char* name) {
+    key->name = name;
+    key->len = strlen(name);
+    key->hash = ctrdl_getELFSymNameHash(name);
+    key->gnuHash = ctrdl_getELFSymNameGnuHash(name);
+}
+
+// Unknown SysV hashes are left to the first lookup in an object without a GNU hash table.
+static inline void ctrdl_makeELFSymKeyHashed(CTRDLSymKey* key, const char* name, size_t len, Elf32_Word gnuHash, Elf32_Word hash) {
+    key->name = name;
+    key->len = len;
+    key->hash = hash;
+    key->gnuHash = gnuHash;
+}
+
+// Keys belong to a single lookup, the SysV hash is cached in place once computed.
+static inline Elf32_Word ctrdl_getELFSymKeyHash(CTRDLSymKey* key) {
+    if (key->hash == CTRDL_SYM_HASH_NONE)
+        key->hash = ctrdl_getELFSymNameHash(key->name);
+
+    return key->hash;
+}
+
+// Names of a different length are rejected before comparing bytes.
+static inline bool ctrdl_matchELFSymName(const CTRDLSymTable* table, const Elf32_Sym* sym, const CTRDLSymKey* key) {
+    const Elf32_Word end = sym->st_name + key->len;
+    if ((end < sym->st_name) || (end >= table->stringTableSize) || table->stringTable[end])
+        return false;
+
+    return !memcmp(&table->stringTable[sym->st_name], key->name, key->len);
+}
+
+// GNU hash tables are preferred, SysV ones are a fallback.
+const Elf32_Sym* ctrdl_findELFSym(const CTRDLSymTable* table, CTRDLSymKey* key, const Elf32_Sym* skip);
+
+// Symbol and relocation tables are not read, and must be accessed through the mapped image.
 bool ctrdl_parseELF(CTRDLStream* stream, CTRDLElf* out);
 void ctrdl_freeELF(CTRDLElf* elf);
+bool ctrdl_bindELFTables(CTRDLElf* elf, u32 imageBase);
+
+// Largest alignment of loaded sections, 0 if unknown.
+size_t ctrdl_getELFAllocAlign(CTRDLStream* stream, const CTRDLElf* elf);
+
+// Copies a string table entry from the stream, for objects whose tables are not bound yet.
+char* ctrdl_readELFString(CTRDLStream* stream, CTRDLElf* elf, Elf32_Word offset);
+
+// Address past the last table byte, tables must be bound.
+Elf32_Addr ctrdl_getELFTablesEnd(const CTRDLElf* elf);
+
+// Memory streams are parsed in place whenever possible.
+static inline bool ctrdl_isELFDataInPlace(const CTRDLElf* elf, const void* p) {
+    return ((const u8*)p >= elf->mapBase) && ((const u8*)p < (elf->mapBase + elf->mapSize));
+}
+
+bool ctrdl_getELFOffsetForAddr(CTRDLElf* elf, Elf32_Addr addr, size_t* out);
 
 size_t ctrdl_getELFNumSegmentsByType(CTRDLElf* elf, Elf32_Word type);
 size_t ctrdl_getELFSegmentsByType(CTRDLElf* elf, Elf32_Word type, Elf32_Phdr* out, size_t maxSize);
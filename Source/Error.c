@@ -41,12 +41,14 @@ const char* ctrdl_getErrorAsString(CTRDLError error) {
 			return "could not map object";
 		case Err_RelocFailed:
 			return "relocation failed";
-		case Err_DepsLimit:
-			return "too many dependencies";
 		case Err_DepFailed:
 			return "could not load dependency";
 		case Err_FreeFailed:
 			return "could not unload object";
+		case Err_Cancelled:
+			return "cancelled";
+		case Err_NotSupported:
+			return "not supported";
 	};
 
 	return NULL;
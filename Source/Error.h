@@ -22,9 +22,10 @@ typedef enum {
     Err_InvalidArch,
     Err_MapFailed,
     Err_RelocFailed,
-    Err_DepsLimit,
     Err_DepFailed,
     Err_FreeFailed,
+    Err_Cancelled,
+    Err_NotSupported,
 } CTRDLError;
 
 CTRDLError ctrdl_getLastError(void);
@@ -10,17 +10,41 @@
 #include "Error.h"
 #include "Loader.h"
 
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 typedef struct {
-    CTRDLHandle** handles;
+    CTRDLHandle* slabs[CTRDL_MAX_HANDLES / CTRDL_HANDLE_SLAB_SIZE]; // Never freed, stale ids always reference a slot.
+    size_t numSlabs;                                                // Number of allocated slabs.
+    CTRDLHandle* freeSlots;                                         // Free slots, linked through next.
+    CTRDLHandle* first;                                             // Oldest handle.
+    CTRDLHandle* last;                                              // Newest handle.
+    size_t size;                                                    // Number of handles.
+} HandleTable;
+
+typedef struct {
+    CTRDLAddrRange* ranges; // Sorted by address, never overlapping.
     size_t size;
     size_t capacity;
-} HandleList;
+} AddrIndex;
 
-static HandleList g_HandleList = {};
+static HandleTable g_HandleTable = {};
+static CTRDLHandle* g_PathBuckets[CTRDL_PATH_INDEX_SIZE] = {};
+static CTRDLHandle** g_PathIndex = g_PathBuckets;
+static size_t g_PathIndexSize = CTRDL_PATH_INDEX_SIZE;
+static AddrIndex g_AddrIndex = {};
 static RecursiveLock g_Mtx;
+static LightLock g_StateLock; // Taken after the handle mutex.
+static CondVar g_StateCond;
+static __thread CTRDLLoad* g_ThreadLoad = NULL;
+
+// Readers register with the current phase, writers flip it and wait for readers of the previous one.
+static CTRDLHandleSnapshot g_Snapshots[2] = { { .generation = 1 } };
+static CTRDLHandleSnapshot* g_Snapshot = &g_Snapshots[0];
+static u32 g_ReadPhase = 0;
+static u32 g_NumReaders[2] = {};
 
 static void ctrdl_handleMtxLazyInit(void) {
     static u8 initialized = 0;
@@ -45,212 +69,692 @@ void ctrdl_releaseHandleMtx(void) {
     RecursiveLock_Unlock(&g_Mtx);
 }
 
-static inline bool ctrdl_handleListIsFull(void) { return g_HandleList.size >= CTRDL_MAX_HANDLES; }
-static inline bool ctrdl_handleListIsEmpty(void) { return g_HandleList.size == 0; }
+static void ctrdl_stateLockLazyInit(void) {
+    static u8 initialized = 0;
 
-// Assumes the list is not full.
-static bool ctrdl_handleListInsert(CTRDLHandle* handle) {
-    // Initialize if not done already.
-    if (!g_HandleList.handles) {
-        g_HandleList.handles = malloc(sizeof(CTRDLHandle*));
-        if (!g_HandleList.handles)
-            return false;
+    if (!__ldrexb(&initialized)) {
+        LightLock_Init(&g_StateLock);
+        CondVar_Init(&g_StateCond);
 
-        g_HandleList.size = 0;
-        g_HandleList.capacity = 1;
+        while (__strexb(&initialized, 1))
+            __ldrexb(&initialized);
+    } else {
+        __clrex();
     }
+}
 
-    // Increase capacity if required.
-    if (g_HandleList.size >= g_HandleList.capacity) {
-        size_t newCapacity = (g_HandleList.capacity * 2);
-        if (newCapacity > CTRDL_MAX_HANDLES)
-            newCapacity = CTRDL_MAX_HANDLES;
+// Waiters are woken up on every change.
+static void ctrdl_setHandleState(CTRDLHandle* handle, CTRDLHandleState state, CTRDLError error) {
+    ctrdl_stateLockLazyInit();
+    LightLock_Lock(&g_StateLock);
+    handle->state = state;
+    handle->loadError = error;
+    handle->loader = NULL;
+    CondVar_Broadcast(&g_StateCond);
+    LightLock_Unlock(&g_StateLock);
+}
 
-        void* p = realloc(g_HandleList.handles, sizeof(CTRDLHandle*) * newCapacity);
-        if (!p)
-            return false;
+void ctrdl_beginLoad(CTRDLLoad* load) {
+    load->parent = g_ThreadLoad;
+    load->waitingOn = NULL;
+    g_ThreadLoad = load;
+}
+
+void ctrdl_endLoad(CTRDLLoad* load) { g_ThreadLoad = load->parent; }
+
+static inline u32 ctrdl_makeHandleId(u32 generation, size_t index) { return (generation << CTRDL_HANDLE_INDEX_BITS) | index; }
+
+// Ids are never NULL, nor the main handle.
+static u32 ctrdl_nextHandleId(u32 id) {
+    const size_t index = id & (CTRDL_MAX_HANDLES - 1);
+    u32 generation = id >> CTRDL_HANDLE_INDEX_BITS;
+
+    do {
+        generation = (generation + 1) & ((1u << (32 - CTRDL_HANDLE_INDEX_BITS)) - 1);
+        id = ctrdl_makeHandleId(generation, index);
+    } while (!generation || (id == (u32)(uintptr_t)CTRDL_MAIN_HANDLE));
+
+    return id;
+}
+
+static CTRDLHandle* ctrdl_handleTableAlloc(void) {
+    HandleTable* table = &g_HandleTable;
+
+    if (!table->freeSlots) {
+        if (table->numSlabs >= (CTRDL_MAX_HANDLES / CTRDL_HANDLE_SLAB_SIZE)) {
+            ctrdl_setLastError(Err_HandleLimit);
+            return NULL;
+        }
+
+        CTRDLHandle* slab = malloc(CTRDL_HANDLE_SLAB_SIZE * sizeof(CTRDLHandle));
+        if (!slab) {
+            ctrdl_setLastError(Err_NoMemory);
+            return NULL;
+        }
+
+        // Pushed in reverse, so that lower slots are used first.
+        for (size_t i = CTRDL_HANDLE_SLAB_SIZE; i-- > 0;) {
+            CTRDLHandle* slot = &slab[i];
+            slot->id = ctrdl_nextHandleId(ctrdl_makeHandleId(0, table->numSlabs * CTRDL_HANDLE_SLAB_SIZE + i));
+            slot->next = table->freeSlots;
+            table->freeSlots = slot;
+        }
 
-        g_HandleList.handles = p;
-        g_HandleList.capacity = newCapacity;
+        __atomic_store_n(&table->slabs[table->numSlabs++], slab, __ATOMIC_RELEASE);
     }
 
-    g_HandleList.handles[g_HandleList.size++] = handle;
-    return true;
+    CTRDLHandle* handle = table->freeSlots;
+    table->freeSlots = handle->next;
+    return handle;
+}
+
+static void ctrdl_handleTableFree(CTRDLHandle* handle) {
+    // Stale ids no longer resolve to the slot.
+    __atomic_store_n(&handle->id, ctrdl_nextHandleId(handle->id), __ATOMIC_RELEASE);
+    handle->next = g_HandleTable.freeSlots;
+    g_HandleTable.freeSlots = handle;
+}
+
+static void ctrdl_handleListInsert(CTRDLHandle* handle) {
+    handle->prevLoaded = g_HandleTable.last;
+    handle->nextLoaded = NULL;
+
+    if (g_HandleTable.last) {
+        g_HandleTable.last->nextLoaded = handle;
+    } else {
+        g_HandleTable.first = handle;
+    }
+
+    g_HandleTable.last = handle;
+    ++g_HandleTable.size;
 }
 
 static void ctrdl_handleListRemove(CTRDLHandle* handle) {
-    if (!g_HandleList.handles)
-        return;
+    if (handle->prevLoaded) {
+        handle->prevLoaded->nextLoaded = handle->nextLoaded;
+    } else {
+        g_HandleTable.first = handle->nextLoaded;
+    }
 
-    // Find handle to remove.
-    size_t index = 0;
-    while (index < g_HandleList.size) {
-        if (g_HandleList.handles[index] == handle)
-            break;
+    if (handle->nextLoaded) {
+        handle->nextLoaded->prevLoaded = handle->prevLoaded;
+    } else {
+        g_HandleTable.last = handle->prevLoaded;
+    }
+
+    --g_HandleTable.size;
+}
 
-        ++index;
+static inline bool ctrdl_isPathSeparator(char c) { return (c == '/') || (c == '\\'); }
+
+static size_t ctrdl_getPathDeviceSize(const char* path) {
+    for (size_t i = 0; path[i] && !ctrdl_isPathSeparator(path[i]); ++i) {
+        if (path[i] == ':')
+            return i + 1;
     }
 
-    if (index >= g_HandleList.size)
-        return;
+    return 0;
+}
+
+// Segments are appended after the root, "." and ".." are resolved.
+static size_t ctrdl_appendPathSegments(char* out, size_t size, size_t rootSize, const char* path) {
+    while (*path) {
+        while (ctrdl_isPathSeparator(*path))
+            ++path;
+
+        const char* segment = path;
+        while (*path && !ctrdl_isPathSeparator(*path))
+            ++path;
+
+        const size_t segmentSize = path - segment;
+        if (!segmentSize || ((segmentSize == 1) && (segment[0] == '.')))
+            continue;
+
+        if ((segmentSize == 2) && (segment[0] == '.') && (segment[1] == '.')) {
+            while ((size > rootSize) && (out[size - 1] != '/'))
+                --size;
+
+            if (size > rootSize)
+                --size;
+
+            continue;
+        }
+
+        out[size++] = '/';
+        memcpy(&out[size], segment, segmentSize);
+        size += segmentSize;
+    }
+
+    return size;
+}
+
+char* ctrdl_canonicalizePath(const char* path) {
+    char cwd[PATH_MAX];
+    const char* parts[2] = { NULL, path };
+    if (!ctrdl_getPathDeviceSize(path) && !ctrdl_isPathSeparator(path[0]) && getcwd(cwd, sizeof(cwd)))
+        parts[0] = cwd;
+
+    const char* first = parts[0] ? parts[0] : parts[1];
+    const size_t deviceSize = ctrdl_getPathDeviceSize(first);
+    const bool isDefaultDevice = (deviceSize == (sizeof(CTRDL_DEFAULT_DEVICE) - 1)) && !memcmp(first, CTRDL_DEFAULT_DEVICE, deviceSize);
+    const size_t rootSize = isDefaultDevice ? 0 : deviceSize;
+
+    char* out = malloc((parts[0] ? strlen(parts[0]) + 1 : 0) + strlen(path) + 2);
+    if (!out)
+        return NULL;
+
+    memcpy(out, first, rootSize);
+    size_t size = rootSize;
 
-    // Ensure the buffer remains contiguous.
-    while (index < (g_HandleList.size - 1)) {
-        g_HandleList.handles[index] = g_HandleList.handles[index + 1];
-        ++index;
+    for (size_t i = 0; i < 2; ++i) {
+        if (parts[i])
+            size = ctrdl_appendPathSegments(out, size, rootSize, parts[i] + ((parts[i] == first) ? deviceSize : 0));
     }
 
-    --g_HandleList.size;
+    if (size == rootSize)
+        out[size++] = '/';
+
+    out[size] = '\0';
+    return out;
+}
+
+u32 ctrdl_hashPath(const char* path) {
+    // FNV-1a.
+    u32 hash = 0x811C9DC5;
+    while (*path) {
+        hash ^= (u8)*path++;
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+static void ctrdl_pathIndexInsert(CTRDLHandle* handle) {
+    CTRDLHandle** bucket = &g_PathIndex[handle->pathHash & (g_PathIndexSize - 1)];
+    handle->next = *bucket;
+    *bucket = handle;
+}
 
-    // Resize if possible.
-    if (g_HandleList.size <= (g_HandleList.capacity / 2)) {
-        if (!g_HandleList.size) {
-            free(g_HandleList.handles);
-            g_HandleList.handles = NULL;
-            g_HandleList.capacity = 0;
-            return;
+static void ctrdl_pathIndexRemove(CTRDLHandle* handle) {
+    CTRDLHandle** link = &g_PathIndex[handle->pathHash & (g_PathIndexSize - 1)];
+    while (*link) {
+        if (*link == handle) {
+            *link = handle->next;
+            break;
         }
 
-        const size_t newCapacity = g_HandleList.capacity / 2;
-        void* p = realloc(g_HandleList.handles, sizeof(CTRDLHandle*) * newCapacity);
-        if (p) {
-            g_HandleList.handles = p;
-            g_HandleList.capacity = newCapacity;
+        link = &(*link)->next;
+    }
+}
+
+// Chains are kept short as handles are added, the index keeps working if it can't grow.
+static void ctrdl_growPathIndex(void) {
+    if (g_HandleTable.size < g_PathIndexSize)
+        return;
+
+    const size_t newSize = g_PathIndexSize * 2;
+    CTRDLHandle** buckets = calloc(newSize, sizeof(CTRDLHandle*));
+    if (!buckets)
+        return;
+
+    for (size_t i = 0; i < g_PathIndexSize; ++i) {
+        CTRDLHandle* handle = g_PathIndex[i];
+        while (handle) {
+            CTRDLHandle* next = handle->next;
+            CTRDLHandle** bucket = &buckets[handle->pathHash & (newSize - 1)];
+            handle->next = *bucket;
+            *bucket = handle;
+            handle = next;
         }
     }
+
+    if (g_PathIndex != g_PathBuckets)
+        free(g_PathIndex);
+
+    g_PathIndex = buckets;
+    g_PathIndexSize = newSize;
+}
+
+static inline CTRDLHandleSnapshot* ctrdl_otherSnapshot(void) { return (g_Snapshot == &g_Snapshots[0]) ? &g_Snapshots[1] : &g_Snapshots[0]; }
+
+static bool ctrdl_growSnapshot(CTRDLHandleSnapshot* snapshot, size_t numGlobals, size_t numRanges) {
+    if (snapshot->maxGlobals < numGlobals) {
+        size_t max = snapshot->maxGlobals ? snapshot->maxGlobals : CTRDL_HANDLE_SLAB_SIZE;
+        while (max < numGlobals)
+            max *= 2;
+
+        void* p = realloc(snapshot->globals, max * sizeof(CTRDLHandle*));
+        if (!p)
+            return false;
+
+        snapshot->globals = p;
+        snapshot->maxGlobals = max;
+    }
+
+    if (snapshot->maxRanges < numRanges) {
+        size_t max = snapshot->maxRanges ? snapshot->maxRanges : CTRDL_HANDLE_SLAB_SIZE;
+        while (max < numRanges)
+            max *= 2;
+
+        void* p = realloc(snapshot->ranges, max * sizeof(CTRDLAddrRange));
+        if (!p)
+            return false;
+
+        snapshot->ranges = p;
+        snapshot->maxRanges = max;
+    }
+
+    return true;
+}
+
+// The current snapshot may be in use, it's replaced by the other one before being grown.
+static bool ctrdl_reserveSnapshots(size_t numGlobals, size_t numRanges) {
+    if (!ctrdl_growSnapshot(ctrdl_otherSnapshot(), numGlobals, numRanges))
+        return false;
+
+    if ((g_Snapshot->maxGlobals < numGlobals) || (g_Snapshot->maxRanges < numRanges)) {
+        ctrdl_unsafeUpdateSnapshot();
+        return ctrdl_growSnapshot(ctrdl_otherSnapshot(), numGlobals, numRanges);
+    }
+
+    return true;
 }
 
-CTRDLHandle* ctrdl_createHandle(const char* path, size_t flags) {
-    size_t pathSize = 0;
+CTRDLHandle* ctrdl_createHandle(const char* path, u32 pathHash, size_t flags) {
     char* pathCopy = NULL;
     if (path) {
-        pathSize = strlen(path);
-        pathCopy = malloc(pathSize + 1);
+        const size_t pathSize = strlen(path) + 1;
+        pathCopy = malloc(pathSize);
         if (!pathCopy) {
             ctrdl_setLastError(Err_NoMemory);
             return NULL;
         }
+
+        memcpy(pathCopy, path, pathSize);
     }
 
     ctrdl_acquireHandleMtx();
 
-    if (ctrdl_handleListIsFull()) {
-        ctrdl_setLastError(Err_HandleLimit);
+    // Every handle may end up in the global scope.
+    if (!ctrdl_reserveSnapshots(g_HandleTable.size + 1, g_AddrIndex.size)) {
         ctrdl_releaseHandleMtx();
+        ctrdl_setLastError(Err_NoMemory);
+        free(pathCopy);
         return NULL;
     }
 
-    // Create handle.
-    CTRDLHandle* handle = malloc(sizeof(CTRDLHandle));
+    CTRDLHandle* handle = ctrdl_handleTableAlloc();
     if (!handle) {
         ctrdl_releaseHandleMtx();
-        ctrdl_setLastError(Err_NoMemory);
         free(pathCopy);
         return NULL;
     }
 
-    // Insert handle in list.
-    if (!ctrdl_handleListInsert(handle)) {
-        ctrdl_setLastError(Err_NoMemory);
-        free(handle);
-        free(pathCopy);
-    }
+    ctrdl_handleListInsert(handle);
 
     // Initialize handle values.
-    if (pathCopy) {
-        memcpy(pathCopy, path, pathSize);
-        pathCopy[pathSize] = '\0';
-    }
-
     handle->path = pathCopy;
+    handle->pathHash = pathCopy ? pathHash : 0;
+    handle->next = NULL;
     handle->base = 0;
     handle->origin = 0;
     handle->numPages = 0;
+    handle->size = 0;
+    handle->donated = false;
+    handle->region = NULL;
+    handle->packedSize = 0;
     handle->refc = 1;
+    handle->published = false;
+    handle->state = CTRDL_HANDLE_LOADING;
+    handle->loadError = Err_OK;
+    handle->loader = g_ThreadLoad;
     handle->flags = flags;
-    memset(handle->deps, 0, sizeof(void*) * CTRDL_MAX_DEPS);
+    handle->deps = NULL;
+    handle->numDeps = 0;
+    handle->scopes = NULL;
+    handle->scopeStamp = 0;
+    handle->initArray = NULL;
+    handle->numInitEntries = 0;
+    handle->initRunning = false;
+    handle->initOwner = NULL;
     handle->finiArray = NULL;
     handle->numFiniEntries = 0;
-    handle->numSymBuckets = 0;
-    handle->symBuckets = NULL;
-    handle->numSymChains = 0;
-    handle->symChains = NULL;
-    handle->symEntries = NULL;
-    handle->stringTable = NULL;
+    memset(&handle->symTable, 0, sizeof(CTRDLSymTable));
+    handle->symAddrs = NULL;
+    handle->numSymAddrs = 0;
+    handle->pltGot = NULL;
+    handle->jmpRel = NULL;
+    handle->numJmpRelEntries = 0;
+    handle->resolver = NULL;
+    handle->resolverUserData = NULL;
+    handle->numSeeks = 0;
+    handle->numReads = 0;
+    handle->numAllocs = 0;
+    handle->numRelocs = 0;
+    handle->numResolvedSyms = 0;
+#ifdef CTRDL_LOAD_STATS
+    memset(&handle->loadStats, 0, sizeof(CTRDLLoadStats));
+#endif // CTRDL_LOAD_STATS
+
+    // Anonymous objects can't be found by name.
+    if (pathCopy) {
+        ctrdl_growPathIndex();
+        ctrdl_pathIndexInsert(handle);
+    }
 
     ctrdl_releaseHandleMtx();
     return handle;
 }
 
+CTRDLHandle* ctrdl_getHandleById(void* id) {
+    const u32 value = (u32)(uintptr_t)id;
+    if (!value || ((uintptr_t)id != value) || (id == CTRDL_MAIN_HANDLE))
+        return NULL;
+
+    // Slots are never freed, ids of closed objects just don't match anymore.
+    const size_t index = value & (CTRDL_MAX_HANDLES - 1);
+    CTRDLHandle* slab = __atomic_load_n(&g_HandleTable.slabs[index / CTRDL_HANDLE_SLAB_SIZE], __ATOMIC_ACQUIRE);
+    if (!slab)
+        return NULL;
+
+    CTRDLHandle* handle = &slab[index & (CTRDL_HANDLE_SLAB_SIZE - 1)];
+    return (__atomic_load_n(&handle->id, __ATOMIC_ACQUIRE) == value) ? handle : NULL;
+}
+
+void* ctrdl_getHandleId(const CTRDLHandle* handle) { return handle ? (void*)(uintptr_t)handle->id : NULL; }
+
 void ctrdl_lockHandle(CTRDLHandle* handle) {
-    if (handle && (handle != CTRDL_MAIN_HANDLE)) {
-        ctrdl_acquireHandleMtx();
-        ++handle->refc;
-        ctrdl_releaseHandleMtx();
+    if (handle)
+        __atomic_add_fetch(&handle->refc, 1, __ATOMIC_RELAXED);
+}
+
+bool ctrdl_tryLockHandle(CTRDLHandle* handle) {
+    size_t refc = __atomic_load_n(&handle->refc, __ATOMIC_RELAXED);
+    while (refc) {
+        if (__atomic_compare_exchange_n(&handle->refc, &refc, refc + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
     }
+
+    return false;
 }
 
-bool ctrdl_unlockHandle(CTRDLHandle* handle) {
-    bool ret = true;
+// Loads waiting on each other are followed, the wait would never end if they lead back to this thread.
+static bool ctrdl_unsafeWouldDeadlock(const CTRDLHandle* handle) {
+    for (; handle && (handle->state == CTRDL_HANDLE_LOADING) && handle->loader; handle = handle->loader->waitingOn) {
+        for (const CTRDLLoad* load = g_ThreadLoad; load; load = load->parent) {
+            if (handle->loader == load)
+                return true;
+        }
+    }
+
+    return false;
+}
 
-    if (handle && (handle != CTRDL_MAIN_HANDLE)) {
-        ctrdl_acquireHandleMtx();
+// Every load of this thread is blocked by the same object.
+static void ctrdl_unsafeSetWaitingOn(CTRDLHandle* handle) {
+    for (CTRDLLoad* load = g_ThreadLoad; load; load = load->parent)
+        load->waitingOn = handle;
+}
 
-        if (handle->refc)
-            --handle->refc;
+static bool ctrdl_waitForHandle(CTRDLHandle* handle, const CTRDLLoad* load) {
+    ctrdl_stateLockLazyInit();
+    LightLock_Lock(&g_StateLock);
 
-        if (!handle->refc) {
-            ret = ctrdl_unloadObject(handle);
-            if (ret) {
-                ctrdl_handleListRemove(handle);
-                free(handle->path);
-                free(handle);
-            }
+    CTRDLError error = Err_OK;
+    while (!load || (handle->loader != load)) {
+        if (handle->state == CTRDL_HANDLE_FAILED) {
+            error = handle->loadError;
+            break;
         }
 
-        ctrdl_releaseHandleMtx();
-    } else {
-        ctrdl_setLastError(Err_InvalidParam);
-        ret = false;
+        if (handle->state == CTRDL_HANDLE_READY)
+            break;
+
+        if (ctrdl_unsafeWouldDeadlock(handle)) {
+            error = Err_DepFailed;
+            break;
+        }
+
+        ctrdl_unsafeSetWaitingOn(handle);
+        CondVar_Wait(&g_StateCond, &g_StateLock);
     }
 
-    return ret;
+    ctrdl_unsafeSetWaitingOn(NULL);
+    LightLock_Unlock(&g_StateLock);
+
+    if (error != Err_OK) {
+        ctrdl_unlockHandle(handle);
+        ctrdl_setLastError(error);
+        return false;
+    }
+
+    return true;
+}
+
+CTRDLHandle* ctrdl_reopenHandle(const char* path, u32 pathHash, int flags, const CTRDLLoad* load, bool* found) {
+    ctrdl_acquireHandleMtx();
+    CTRDLHandle* handle = ctrdl_unsafeFindHandleByName(path, pathHash);
+    ctrdl_lockHandle(handle);
+    ctrdl_releaseHandleMtx();
+
+    if (found)
+        *found = handle != NULL;
+
+    // Objects are shared before being published only within the same load, other loads are waited for.
+    if (!handle || !ctrdl_waitForHandle(handle, load))
+        return NULL;
+
+    ctrdl_acquireHandleMtx();
+
+    // Update flags.
+    // Once GLOBAL, forever GLOBAL.
+    if (handle->flags & RTLD_GLOBAL)
+        flags &= ~(RTLD_LOCAL);
+
+    const bool promoted = !(handle->flags & RTLD_GLOBAL) && (flags & RTLD_GLOBAL);
+    handle->flags = (flags & ~(RTLD_NOLOAD));
+
+    // Global lookups may now find this object first.
+    if (promoted && handle->published)
+        ctrdl_unsafeUpdateSnapshot();
+
+    ctrdl_releaseHandleMtx();
+    return handle;
 }
 
-size_t ctrdl_unsafeNumHandles(void) { return g_HandleList.size; }
+void ctrdl_failHandle(CTRDLHandle* handle, CTRDLError error) {
+    ctrdl_acquireHandleMtx();
+
+    if (handle->state == CTRDL_HANDLE_LOADING) {
+        if (handle->path)
+            ctrdl_pathIndexRemove(handle);
+
+        ctrdl_setHandleState(handle, CTRDL_HANDLE_FAILED, error);
+    }
 
-CTRDLHandle* ctrdl_unsafeGetHandleByIndex(size_t index) {
-    if (index < g_HandleList.size)
-        return g_HandleList.handles[index];
-    
-    return NULL;
+    ctrdl_releaseHandleMtx();
 }
 
-CTRDLHandle* ctrdl_unsafeFindHandleByName(const char* name) {
-    CTRDLHandle* found = NULL;
+bool ctrdl_unlockHandle(CTRDLHandle* handle) {
+    if (!handle) {
+        ctrdl_setLastError(Err_InvalidParam);
+        return false;
+    }
 
-    for (size_t i = 0; i < ctrdl_unsafeNumHandles(); ++i) {
-        CTRDLHandle* h = ctrdl_unsafeGetHandleByIndex(i);
-        if (h->path && strstr(h->path, name)) {
-            found = h;
-            break;
+    // Other references remain, the object stays loaded.
+    size_t refc = __atomic_load_n(&handle->refc, __ATOMIC_RELAXED);
+    while (refc > 1) {
+        if (__atomic_compare_exchange_n(&handle->refc, &refc, refc - 1, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return true;
+    }
+
+    bool ret = true;
+    ctrdl_acquireHandleMtx();
+
+    // Lock-free readers may have taken a reference meanwhile, but can't revive the object afterwards.
+    size_t remaining = __atomic_load_n(&handle->refc, __ATOMIC_RELAXED);
+    if (remaining)
+        remaining = __atomic_sub_fetch(&handle->refc, 1, __ATOMIC_ACQ_REL);
+
+    if (!remaining) {
+        ret = ctrdl_unloadObject(handle);
+        if (ret) {
+            ctrdl_handleListRemove(handle);
+            if (handle->path && (handle->state != CTRDL_HANDLE_FAILED))
+                ctrdl_pathIndexRemove(handle);
+
+            free(handle->path);
+            ctrdl_handleTableFree(handle);
         }
     }
 
+    ctrdl_releaseHandleMtx();
+    return ret;
+}
+
+size_t ctrdl_unsafeNumHandles(void) { return g_HandleTable.size; }
+
+CTRDLHandle* ctrdl_unsafeNextHandle(const CTRDLHandle* handle) { return handle ? handle->nextLoaded : g_HandleTable.first; }
+
+CTRDLHandle* ctrdl_unsafeFindHandleByName(const char* path, u32 pathHash) {
+    CTRDLHandle* found = g_PathIndex[pathHash & (g_PathIndexSize - 1)];
+    while (found && ((found->pathHash != pathHash) || strcmp(found->path, path)))
+        found = found->next;
+
     return found;
 }
 
-CTRDLHandle* ctrdl_unsafeFindHandleByAddr(u32 addr) {
-    CTRDLHandle* found = NULL;
+bool ctrdl_unsafeInsertAddrRange(CTRDLHandle* handle, u32 begin, u32 end) {
+    if (begin >= end)
+        return true;
 
-    for (size_t i = 0; i < ctrdl_unsafeNumHandles(); ++i) {
-        CTRDLHandle* h = ctrdl_unsafeGetHandleByIndex(i);
-        const size_t size = ctrlNumPagesToSize(h->numPages);
-        if ((addr >= h->base) && (addr <= (h->base + size))) {
-            found = h;
-            break;
+    if (g_AddrIndex.size >= g_AddrIndex.capacity) {
+        const size_t newCapacity = g_AddrIndex.capacity ? (g_AddrIndex.capacity * 2) : CTRDL_HANDLE_SLAB_SIZE;
+        void* p = realloc(g_AddrIndex.ranges, newCapacity * sizeof(CTRDLAddrRange));
+        if (!p)
+            return false;
+
+        g_AddrIndex.ranges = p;
+        g_AddrIndex.capacity = newCapacity;
+    }
+
+    if (!ctrdl_reserveSnapshots(g_HandleTable.size, g_AddrIndex.size + 1))
+        return false;
+
+    size_t index = g_AddrIndex.size;
+    while (index && (g_AddrIndex.ranges[index - 1].begin > begin))
+        --index;
+
+    memmove(&g_AddrIndex.ranges[index + 1], &g_AddrIndex.ranges[index], (g_AddrIndex.size - index) * sizeof(CTRDLAddrRange));
+    g_AddrIndex.ranges[index].begin = begin;
+    g_AddrIndex.ranges[index].end = end;
+    g_AddrIndex.ranges[index].handle = handle;
+    ++g_AddrIndex.size;
+    return true;
+}
+
+static void ctrdl_removeAddrRanges(CTRDLHandle* handle) {
+    size_t size = 0;
+    for (size_t i = 0; i < g_AddrIndex.size; ++i) {
+        if (g_AddrIndex.ranges[i].handle != handle)
+            g_AddrIndex.ranges[size++] = g_AddrIndex.ranges[i];
+    }
+
+    g_AddrIndex.size = size;
+}
+
+void ctrdl_unsafeWaitForReaders(void) {
+    const u32 phase = __atomic_fetch_add(&g_ReadPhase, 1, __ATOMIC_SEQ_CST) & 1;
+
+    // Spinning could starve a lower priority reader, sleep instead.
+    while (__atomic_load_n(&g_NumReaders[phase], __ATOMIC_SEQ_CST))
+        svcSleepThread(CTRDL_READER_WAIT_NS);
+}
+
+void ctrdl_unsafeUpdateSnapshot(void) {
+    // Readers of the other buffer were waited for by the previous update, it was reserved to fit.
+    const CTRDLHandleSnapshot* current = g_Snapshot;
+    CTRDLHandleSnapshot* next = ctrdl_otherSnapshot();
+
+    next->generation = current->generation + 1;
+    if (!next->generation)
+        next->generation = 1;
+
+    next->numGlobals = 0;
+    for (CTRDLHandle* h = g_HandleTable.first; h; h = h->nextLoaded) {
+        if (h->published && (h->flags & RTLD_GLOBAL))
+            next->globals[next->numGlobals++] = h;
+    }
+
+    if (g_AddrIndex.size)
+        memcpy(next->ranges, g_AddrIndex.ranges, g_AddrIndex.size * sizeof(CTRDLAddrRange));
+
+    next->numRanges = g_AddrIndex.size;
+
+    __atomic_store_n(&g_Snapshot, next, __ATOMIC_SEQ_CST);
+    ctrdl_unsafeWaitForReaders();
+}
+
+void ctrdl_unsafePublishHandle(CTRDLHandle* handle) {
+    handle->published = true;
+    ctrdl_unsafeUpdateSnapshot();
+    ctrdl_setHandleState(handle, CTRDL_HANDLE_READY, Err_OK);
+}
+
+void ctrdl_unsafeUnpublishHandle(CTRDLHandle* handle) {
+    ctrdl_removeAddrRanges(handle);
+
+    if (handle->published) {
+        handle->published = false;
+        ctrdl_unsafeUpdateSnapshot();
+    }
+}
+
+const CTRDLHandleSnapshot* ctrdl_beginRead(u32* phase) {
+    // The phase may flip before the reader is counted, retry with the new one.
+    for (;;) {
+        const u32 p = __atomic_load_n(&g_ReadPhase, __ATOMIC_SEQ_CST) & 1;
+        __atomic_add_fetch(&g_NumReaders[p], 1, __ATOMIC_SEQ_CST);
+
+        if ((__atomic_load_n(&g_ReadPhase, __ATOMIC_SEQ_CST) & 1) == p) {
+            *phase = p;
+            return __atomic_load_n(&g_Snapshot, __ATOMIC_SEQ_CST);
         }
+
+        __atomic_sub_fetch(&g_NumReaders[p], 1, __ATOMIC_RELEASE);
     }
+}
 
-    return found;
-}
\ No newline at end of file
+void ctrdl_endRead(u32 phase) { __atomic_sub_fetch(&g_NumReaders[phase], 1, __ATOMIC_RELEASE); }
+
+static CTRDLHandle* ctrdl_searchAddrRanges(const CTRDLHandleSnapshot* snapshot, u32 addr) {
+    // Find the last range starting at or before the address.
+    size_t low = 0;
+    size_t high = snapshot->numRanges;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        if (snapshot->ranges[mid].begin <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (!low)
+        return NULL;
+
+    const CTRDLAddrRange* range = &snapshot->ranges[low - 1];
+    return addr < range->end ? range->handle : NULL;
+}
+
+CTRDLHandle* ctrdl_lockHandleByAddr(u32 addr) {
+    u32 phase;
+    const CTRDLHandleSnapshot* snapshot = ctrdl_beginRead(&phase);
+
+    CTRDLHandle* handle = ctrdl_searchAddrRanges(snapshot, addr);
+    if (handle && !ctrdl_tryLockHandle(handle))
+        handle = NULL;
+
+    ctrdl_endRead(phase);
+    return handle;
+}
@@ -9,41 +9,156 @@
 
 #include <dlfcn.h>
 
+#include "CodeRegion.h"
 #include "ELFUtil.h"
 
-#define CTRDL_MAX_HANDLES 32
-#define CTRDL_MAX_DEPS 16
+#define CTRDL_HANDLE_INDEX_BITS 16
+#define CTRDL_HANDLE_SLAB_SIZE 64 // Power of two.
+#define CTRDL_MAX_HANDLES (1 << CTRDL_HANDLE_INDEX_BITS) // Bounded by the id space only.
 
-#define CTRDL_MAIN_HANDLE (CTRDLHandle*)(0x75107510)
+#define CTRDL_PATH_INDEX_SIZE 64 // Initial size, power of two.
+#define CTRDL_DEFAULT_DEVICE "sdmc:"
+#define CTRDL_READER_WAIT_NS 100000LL
+
+#define CTRDL_MAIN_HANDLE ((void*)0x75107510)
 
 typedef struct {
-    char* path;                 // Object path.
+    Elf32_Addr addr;   // Symbol address.
+    Elf32_Word index;  // Symbol index.
+} CTRDLSymAddr;
+
+typedef struct CTRDLHandle CTRDLHandle;
+
+typedef enum {
+    CTRDL_HANDLE_LOADING, // Found by name, but not published yet.
+    CTRDL_HANDLE_READY,   // Published.
+    CTRDL_HANDLE_FAILED,  // Load failed, no longer found by name.
+} CTRDLHandleState;
+
+typedef struct CTRDLLoad {
+    struct CTRDLLoad* parent; // Load whose initializers started this one, on the same thread.
+    CTRDLHandle* waitingOn;   // Object of another load being waited for.
+} CTRDLLoad;
+
+typedef struct {
+    u32 begin;           // First address.
+    u32 end;             // Address past the range.
+    CTRDLHandle* handle; // Owner.
+} CTRDLAddrRange;
+
+typedef struct {
+    u32 generation;         // Changes with every update, never 0.
+    size_t numGlobals;      // Number of global objects.
+    size_t maxGlobals;      // Capacity of the global objects array.
+    CTRDLHandle** globals;  // Published RTLD_GLOBAL objects, in load order.
+    size_t numRanges;       // Number of address ranges.
+    size_t maxRanges;       // Capacity of the address ranges array.
+    CTRDLAddrRange* ranges; // Ranges of published objects, sorted by address.
+} CTRDLHandleSnapshot;
+
+typedef struct {
+    size_t size;            // Number of objects in each scope.
+    CTRDLHandle* handles[]; // Load order, dependency order and init order scopes.
+} CTRDLScopes;
+
+struct CTRDLHandle {
+    char* path;                 // Object path, canonicalized.
+    u32 pathHash;               // Object path hash.
+    struct CTRDLHandle* next;   // Next handle in the same path bucket, or next free slot.
+    CTRDLHandle* prevLoaded;    // Previous handle in load order.
+    CTRDLHandle* nextLoaded;    // Next handle in load order.
+    u32 id;                     // Opaque id, changes whenever the slot is reused.
     u32 base;                   // Mirror address of mapped region.
     u32 origin;                 // Original address of mapped region.
     size_t numPages;            // Size of mapped region in pages.
-    size_t refc;                // Object refcount.
+    size_t size;                // Size of the image in bytes.
+    bool donated;               // Mapped region was donated by the caller.
+    CTRDLCodeRegion* region;    // Code region shared with other objects, if packed.
+    size_t packedSize;          // Bytes used in the shared region.
+    size_t refc;                // Object refcount, atomic.
+    bool published;             // Visible to lock-free readers.
+    CTRDLHandleState state;     // Load state, changed under both the handle mutex and the state lock.
+    CTRDLError loadError;       // Error of the failed load.
+    CTRDLLoad* loader;          // Load which created the object, until it's published or failed.
     size_t flags;               // Object flags.
-    void* deps[CTRDL_MAX_DEPS]; // Object dependencies.
+    CTRDLHandle** deps;         // Object dependencies, detached ones are NULL.
+    size_t numDeps;             // Number of dependencies.
+    CTRDLScopes* scopes;        // Flattened lookup scopes, built once dependencies are final.
+    u32 scopeStamp;             // Last scope walk which visited the object.
+    Elf32_Addr* initArray;      // Init array address, while initializers are deferred.
+    size_t numInitEntries;      // Number of deferred init functions.
+    bool initRunning;           // Initializers were claimed and are still running.
+    const void* initOwner;      // Thread running the initializers.
     Elf32_Addr* finiArray;      // Fini array address.
     size_t numFiniEntries;      // Number of fini functions.
-    size_t numSymBuckets;       // Number of symbol buckets;
-    Elf32_Word* symBuckets;     // Symbol buckets.
-    size_t numSymChains;        // Number of symbol chains (entries).
-    Elf32_Word* symChains;      // Symbol chains.
-    Elf32_Sym* symEntries;      // Symbol entries.
-    char* stringTable;          // String table.
-} CTRDLHandle;
+    CTRDLSymTable symTable;     // Symbol lookup tables.
+    CTRDLSymAddr* symAddrs;     // Defined symbols sorted by address, built on first use.
+    size_t numSymAddrs;         // Number of sorted symbols.
+    u32* pltGot;                // PLT GOT, for lazy binding.
+    const Elf32_Rel* jmpRel;    // Jump slot relocations, for lazy binding.
+    size_t numJmpRelEntries;    // Number of jump slot relocations.
+    CTRDLResolverFn resolver;   // Resolver, for lazy binding.
+    void* resolverUserData;     // Resolver user data.
+    size_t numSeeks;            // Stream seeks issued while loading.
+    size_t numReads;            // Stream reads issued while loading.
+    size_t numAllocs;           // Metadata allocations made while loading.
+    size_t numRelocs;           // Relocations applied while loading.
+    size_t numResolvedSyms;     // Distinct symbols resolved while loading.
+#ifdef CTRDL_LOAD_STATS
+    CTRDLLoadStats loadStats;   // Phase timings and counts of this object.
+#endif // CTRDL_LOAD_STATS
+};
 
 void ctrdl_acquireHandleMtx(void);
 void ctrdl_releaseHandleMtx(void);
 
-CTRDLHandle* ctrdl_createHandle(const char* path, size_t flags);
+// Objects created meanwhile belong to the innermost load of the calling thread.
+void ctrdl_beginLoad(CTRDLLoad* load);
+void ctrdl_endLoad(CTRDLLoad* load);
+
+// Relative paths start from the working directory, and the default device is implied; NULL if out of memory.
+char* ctrdl_canonicalizePath(const char* path);
+u32 ctrdl_hashPath(const char* path);
+
+// Paths are canonical and copied, anonymous objects have none.
+CTRDLHandle* ctrdl_createHandle(const char* path, u32 pathHash, size_t flags);
+// Lock-free, stale ids and the main handle are not resolved.
+CTRDLHandle* ctrdl_getHandleById(void* id);
+void* ctrdl_getHandleId(const CTRDLHandle* handle);
+// Callers must already hold a reference, or the handle mutex.
 void ctrdl_lockHandle(CTRDLHandle* handle);
+// Lock-free, fails for objects which lost their last reference.
+bool ctrdl_tryLockHandle(CTRDLHandle* handle);
+// Objects of other loads are waited for until published, those of the given load are returned as they are.
+// Returns NULL if not found, or if the load failed (then found is still set).
+CTRDLHandle* ctrdl_reopenHandle(const char* path, u32 pathHash, int flags, const CTRDLLoad* load, bool* found);
+// Objects still loading are removed from the path index, threads waiting for them give up.
+void ctrdl_failHandle(CTRDLHandle* handle, CTRDLError error);
+// The handle mutex is only taken to drop the last reference.
 bool ctrdl_unlockHandle(CTRDLHandle* handle);
 
 size_t ctrdl_unsafeNumHandles(void);
-CTRDLHandle* ctrdl_unsafeGetHandleByIndex(size_t index);
-CTRDLHandle* ctrdl_unsafeFindHandleByName(const char* name);
-CTRDLHandle* ctrdl_unsafeFindHandleByAddr(u32 addr);
+// Handles are iterated in load order, NULL starts from the first one.
+CTRDLHandle* ctrdl_unsafeNextHandle(const CTRDLHandle* handle);
+// Paths are canonical, only the bucket of the hash is searched.
+CTRDLHandle* ctrdl_unsafeFindHandleByName(const char* path, u32 pathHash);
+
+// Ranges of different objects never overlap, they are visible once the object is published.
+// Fails if the snapshots could not be grown to fit the range.
+bool ctrdl_unsafeInsertAddrRange(CTRDLHandle* handle, u32 begin, u32 end);
+
+// Updates wait for readers of the previous snapshot before returning.
+void ctrdl_unsafePublishHandle(CTRDLHandle* handle);
+void ctrdl_unsafeUnpublishHandle(CTRDLHandle* handle);
+void ctrdl_unsafeUpdateSnapshot(void);
+// Returns once every read that began before the call has ended.
+void ctrdl_unsafeWaitForReaders(void);
+
+// Readers never block, the snapshot and its objects remain valid until the read ends; reads may be nested.
+const CTRDLHandleSnapshot* ctrdl_beginRead(u32* phase);
+void ctrdl_endRead(u32 phase);
+
+// Lock-free, objects being unloaded are not returned.
+CTRDLHandle* ctrdl_lockHandleByAddr(u32 addr);
 
 #endif /* _CTRDL_HANDLE_H */
\ No newline at end of file
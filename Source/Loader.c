@@ -8,9 +8,14 @@
 #include <CTRL/Memory.h>
 
 #include "Loader.h"
+#include "CodeRegion.h"
 #include "Handle.h"
 #include "ELFUtil.h"
+#include "ReadPlan.h"
 #include "Relocs.h"
+#include "Stats.h"
+#include "Symbol.h"
+#include "Worker.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -21,14 +26,80 @@ u32 __ctrl_code_allocator_pages = CTRDL_RESERVED_CODE_PAGES;
 u32 __ctrl_code_allocator_pages = 256; // Default to 1MB.
 #endif // CTRDL_RESERVED_CODE_PAGES
 
+#ifndef CTRDL_DEFAULT_PIPELINE_CHUNK_SIZE
+#define CTRDL_DEFAULT_PIPELINE_CHUNK_SIZE 0
+#endif // CTRDL_DEFAULT_PIPELINE_CHUNK_SIZE
+
+#define VISIT_NONE 0
+#define VISIT_ACTIVE 1
+#define VISIT_DONE 2
+
 typedef struct {
     CTRDLHandle* handle;
     CTRDLStream* stream;
     CTRDLElf elf;
+    CTRDLReadPlan plan;
     CTRDLResolverFn resolver;
     void* resolverUserData;
+    bool deferInit;
+    bool pipelined;           // Writable segments are read while relocating.
+    Elf32_Addr writableBegin; // Lowest writable address.
+    size_t chunkSize;         // Pipeline chunk size.
+    bool packed;              // Placed in a region shared with other objects.
+    CTRDLPackLayout layout;   // Layout within the shared region.
 } LdrData;
 
+typedef struct {
+    LdrData* data;
+    LightLock lock;
+    CondVar cond;
+    Elf32_Addr readEnd; // The image is final below this address.
+    bool done;          // No more data will be read.
+    CTRDLError error;   // Errors are thread local, the reader reports them here.
+} LdrReader;
+
+typedef struct LdrNode {
+    LdrData data;
+    FILE* file;              // Dependency file, the root stream belongs to the caller.
+    CTRDLStream fileStream;  // Dependency stream.
+    CTRDLJob job;            // Prepare job.
+    bool ready;              // Prepared (or finished) successfully.
+    CTRDLError error;        // Errors are thread local, workers report them here.
+    size_t numSeeks;         // Stream seeks before loading.
+    size_t numReads;         // Stream reads before loading.
+#ifdef CTRDL_LOAD_STATS
+    size_t bytesRead;        // Stream bytes read before loading.
+#endif // CTRDL_LOAD_STATS
+    struct LdrNode** deps;   // Dependencies loaded along with this object, parallel to the handle ones.
+    size_t nextDep;          // Next dependency to visit while sorting.
+    u8 visit;                // Visit state while sorting.
+} LdrNode;
+
+typedef struct {
+    LdrNode** nodes;
+    size_t numNodes;
+    size_t maxNodes;
+    CTRDLJobGroup group;
+    CTRDLResolverFn resolver;
+    void* resolverUserData;
+    const CTRDLLoadOptions* options;
+    CTRDLLoad load;         // Owns the objects created by this graph.
+#ifdef CTRDL_LOAD_STATS
+    u64 startTick;          // Tick at which the load started.
+    CTRDLLoadStats stats;   // Work shared by all objects, such as packing.
+#endif // CTRDL_LOAD_STATS
+} LdrGraph;
+
+static size_t g_PipelineChunkSize = CTRDL_DEFAULT_PIPELINE_CHUNK_SIZE;
+static LightLock g_InitLock;
+static CondVar g_InitCond;
+static __thread u8 g_InitToken; // Its address identifies the thread.
+
+#ifdef CTRDL_LOAD_STATS
+static CTRDLLoadStatsCallback g_LoadStatsCallback = NULL;
+static void* g_LoadStatsUserData = NULL;
+#endif // CTRDL_LOAD_STATS
+
 static MemPerm ctrdl_wrapPerms(Elf32_Word flags) {
     switch (flags) {
         case PF_R:
@@ -71,96 +142,354 @@ static char* ctrdl_getDepPath(const char* basePath, const char* name) {
     return buffer;
 }
 
-static bool ctrdl_loadDeps(LdrData* ldrData, bool local, bool hasResolver) {
-    const size_t depCount = ctrdl_getELFNumDynEntriesWithTag(&ldrData->elf, DT_NEEDED);
-    if (depCount > CTRDL_MAX_DEPS) {
-        if (!hasResolver) {
-            ctrdl_setLastError(Err_DepsLimit);
+// Donated buffers are adopted as code pages when the file layout matches the memory layout.
+static u32 ctrdl_adoptDonatedBuffer(LdrData* ldrData, u32 lowestAddr) {
+    if (!(ldrData->handle->flags & CTRDL_MAP_DONATE) || lowestAddr)
+        return 0;
+
+    const u32 buffer = (u32)ctrdl_streamMap(ldrData->stream, 0, ctrlNumPagesToSize(ldrData->handle->numPages));
+    if (!buffer || (buffer & (CTRL_PAGE_SIZE - 1)))
+        return 0;
+
+    // Everything parsed in place must be part of the image; tables are, since they are found through the segments.
+    const CTRDLElf* elf = &ldrData->elf;
+    const u32 imageEnd = buffer + ctrlNumPagesToSize(ldrData->handle->numPages);
+    if (ctrdl_isELFDataInPlace(elf, elf->segments) && ((u32)(elf->segments + elf->header.e_phnum) > imageEnd))
+        return 0;
+
+    if (ctrdl_isELFDataInPlace(elf, elf->dynEntries) && ((u32)elf->dynEntries >= imageEnd))
+        return 0;
+
+    for (size_t i = 0; i < elf->header.e_phnum; ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if ((segment->p_type == PT_LOAD) && (segment->p_offset != segment->p_vaddr))
+            return 0;
+    }
+
+    return buffer;
+}
+
+static inline void* ctrdl_rebaseDonatedData(LdrData* ldrData, void* p) {
+    if (!ctrdl_isELFDataInPlace(&ldrData->elf, p))
+        return p;
+
+    return (void*)(ldrData->handle->base + ((u32)p - ldrData->handle->origin));
+}
+
+static void ctrdl_rebaseDonatedELF(LdrData* ldrData) {
+    CTRDLElf* elf = &ldrData->elf;
+    elf->segments = ctrdl_rebaseDonatedData(ldrData, elf->segments);
+    elf->dynEntries = ctrdl_rebaseDonatedData(ldrData, elf->dynEntries);
+    elf->mapBase = (const u8*)ldrData->handle->base;
+    elf->mapSize = ctrlNumPagesToSize(ldrData->handle->numPages);
+}
+
+// Writable segments may be streamed after commit, if they follow every other segment and hold no tables.
+static bool ctrdl_planPipeline(LdrData* ldrData) {
+    const CTRDLElf* elf = &ldrData->elf;
+    ldrData->chunkSize = __atomic_load_n(&g_PipelineChunkSize, __ATOMIC_RELAXED);
+    if (!ldrData->chunkSize || ldrData->handle->donated)
+        return false;
+
+    Elf32_Addr writableBegin = -1;
+    Elf32_Addr readOnlyEnd = 0;
+
+    for (size_t i = 0; i < elf->header.e_phnum; ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if (segment->p_type != PT_LOAD)
+            continue;
+
+        if (segment->p_flags & PF_W) {
+            if (segment->p_vaddr < writableBegin)
+                writableBegin = segment->p_vaddr;
+        } else if ((segment->p_vaddr + segment->p_memsz) > readOnlyEnd) {
+            readOnlyEnd = segment->p_vaddr + segment->p_memsz;
+        }
+    }
+
+    if ((writableBegin == (Elf32_Addr)-1) || (readOnlyEnd > writableBegin))
+        return false;
+
+    // Table sizes are only known once bound, headers must be read beforehand.
+    const Elf32_Addr hashEnd = elf->gnuHashAddr ? (elf->gnuHashAddr + 4 * sizeof(Elf32_Word)) : (elf->hashAddr + 2 * sizeof(Elf32_Word));
+    if ((hashEnd > writableBegin) || (elf->symtabAddr >= writableBegin))
+        return false;
+
+    ldrData->writableBegin = writableBegin;
+    return true;
+}
+
+static bool ctrdl_readSegments(LdrData* ldrData, bool readOnly, bool writable) {
+    CTRDLHandle* handle = ldrData->handle;
+    const CTRDLElf* elf = &ldrData->elf;
+    ctrdl_planInit(&ldrData->plan);
+
+    for (size_t i = 0; i < elf->header.e_phnum; ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if ((segment->p_type != PT_LOAD) || !((segment->p_flags & PF_W) ? writable : readOnly))
+            continue;
+
+        if (!ctrdl_planAdd(&ldrData->plan, segment->p_offset, segment->p_filesz, (void*)(handle->origin + segment->p_vaddr))) {
+            ctrdl_setLastError(Err_InvalidObject);
             return false;
         }
+    }
 
-        return true;
+    CTRDL_STATS_BEGIN(tick);
+    const bool success = ctrdl_planExecute(&ldrData->plan, ldrData->stream);
+    CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_READ, tick);
+    return success;
+}
+
+static const Elf32_Phdr* ctrdl_nextWritableSegment(const CTRDLElf* elf, Elf32_Addr addr) {
+    const Elf32_Phdr* next = NULL;
+
+    for (size_t i = 0; i < elf->header.e_phnum; ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if ((segment->p_type == PT_LOAD) && (segment->p_flags & PF_W) && (segment->p_vaddr >= addr) && (!next || (segment->p_vaddr < next->p_vaddr)))
+            next = segment;
     }
 
-    Elf32_Dyn depEntries[CTRDL_MAX_DEPS];
-    const size_t actualDepCount = ctrdl_getELFDynEntriesWithTag(&ldrData->elf, DT_NEEDED, depEntries, CTRDL_MAX_DEPS);
-    if (actualDepCount != depCount) {
-        if (!hasResolver) {
-            ctrdl_setLastError(Err_DepFailed);
-            return false;
+    return next;
+}
+
+static void ctrdl_publishChunk(LdrReader* reader, Elf32_Addr readEnd) {
+    LightLock_Lock(&reader->lock);
+    reader->readEnd = readEnd;
+    CondVar_Signal(&reader->cond);
+    LightLock_Unlock(&reader->lock);
+}
+
+static void ctrdl_readJob(void* arg) {
+    LdrReader* reader = (LdrReader*)arg;
+    LdrData* ldrData = reader->data;
+    const CTRDLElf* elf = &ldrData->elf;
+    const u32 base = ldrData->handle->base;
+    bool success = true;
+    CTRDL_STATS_BEGIN(tick);
+
+    // Segments are read in address order, so that the watermark only grows.
+    const Elf32_Phdr* segment = ctrdl_nextWritableSegment(elf, 0);
+    while (segment && success) {
+        for (size_t offset = 0; success && (offset < segment->p_filesz); offset += ldrData->chunkSize) {
+            const size_t size = (segment->p_filesz - offset) < ldrData->chunkSize ? (segment->p_filesz - offset) : ldrData->chunkSize;
+            success = ctrdl_streamSeek(ldrData->stream, segment->p_offset + offset) &&
+                ctrdl_streamRead(ldrData->stream, (void*)(base + segment->p_vaddr + offset), size);
+
+            if (success)
+                ctrdl_publishChunk(reader, segment->p_vaddr + offset + size);
         }
 
-        return true;
+        // Code pages come zeroed, .bss is ready as well.
+        if (success)
+            ctrdl_publishChunk(reader, segment->p_vaddr + segment->p_memsz);
+
+        segment = ctrdl_nextWritableSegment(elf, segment->p_vaddr + (segment->p_memsz ? segment->p_memsz : 1));
     }
 
-    for (size_t i = 0; i < depCount; ++i) {
-        char* depPath = ctrdl_getDepPath(ldrData->handle->path, ldrData->elf.stringTable + depEntries[i].d_un.d_ptr);
-        void* depHandle = ctrdlOpen(depPath, RTLD_NOW | (local ? RTLD_LOCAL : RTLD_GLOBAL), ldrData->resolver, ldrData->resolverUserData);
-        free(depPath);
+    // Accounted before signaling, the loading thread may read the stats afterwards.
+    CTRDL_STATS_END(&ldrData->handle->loadStats, CTRDL_PHASE_READ, tick);
 
-        if (!depHandle) {
-            if (!hasResolver) {
-                ctrdl_setLastError(Err_DepFailed);
-                return false;
-            }
+    LightLock_Lock(&reader->lock);
+    reader->done = true;
+    reader->error = success ? Err_OK : Err_ReadFailed;
+    CondVar_Signal(&reader->cond);
+    LightLock_Unlock(&reader->lock);
+}
+
+// Returns whether the reader is done.
+static bool ctrdl_waitForChunk(LdrReader* reader, Elf32_Addr* readEnd) {
+    LightLock_Lock(&reader->lock);
+
+    while (!reader->done && (reader->readEnd == *readEnd))
+        CondVar_Wait(&reader->cond, &reader->lock);
+
+    *readEnd = reader->readEnd;
+    const bool done = reader->done;
+    LightLock_Unlock(&reader->lock);
+    return done;
+}
+
+// Symbols are resolved while writable segments are read, and relocations are applied as soon as their chunk is.
+static bool ctrdl_pipelineRelocs(LdrData* ldrData) {
+    LdrReader reader;
+    reader.data = ldrData;
+    LightLock_Init(&reader.lock);
+    CondVar_Init(&reader.cond);
+    reader.readEnd = ldrData->writableBegin;
+    reader.done = false;
+    reader.error = Err_OK;
+
+    CTRDLJobGroup group;
+    CTRDLJob job;
+    ctrdl_jobGroupInit(&group);
+    ctrdl_jobSubmit(&group, &job, ctrdl_readJob, &reader);
+
+    CTRDLRelocPipeline* pipeline = ctrdl_beginRelocs(ldrData->handle, &ldrData->elf, ldrData->resolver, ldrData->resolverUserData);
+    bool relocated = pipeline != NULL;
+    Elf32_Addr readEnd = 0;
+    bool done = false;
+
+    while (relocated && !done) {
+        done = ctrdl_waitForChunk(&reader, &readEnd);
+        relocated = ctrdl_applyRelocsBelow(pipeline, readEnd);
+    }
+
+    // The reader must be done with the image before returning.
+    ctrdl_jobGroupWait(&group);
+
+    if (reader.error != Err_OK) {
+        if (pipeline)
+            ctrdl_abortRelocs(pipeline);
 
-            return true;
+        ctrdl_setLastError(reader.error);
+        return false;
+    }
+
+    if (pipeline) {
+        if (relocated) {
+            relocated = ctrdl_endRelocs(pipeline);
+        } else {
+            ctrdl_abortRelocs(pipeline);
         }
+    }
 
-        ldrData->handle->deps[i] = depHandle;
+    if (!relocated) {
+        ctrdl_setLastError(Err_RelocFailed);
+        return false;
     }
 
     return true;
 }
 
 static inline void ctrdl_callInitFini(Elf32_Addr addr) {
+#ifdef __arm__
     if (addr != 0 && addr != -1)
         ((void(*)(void))(addr))();
+#else
+    // Host builds never run object code.
+    (void)addr;
+#endif // __arm__
 }
 
-static bool ctrdl_mapObject(LdrData* ldrData) {
-    CTRDLHandle* handle = ldrData->handle;
+static void ctrdl_initLockLazyInit(void) {
+    static u8 initialized = 0;
 
-    // Load dependencies (references may be resolved by the user).
-    if (!ctrdl_loadDeps(ldrData, ldrData->handle->flags & RTLD_LOCAL, ldrData->resolver)) {
-        ctrdl_unloadObject(handle);
-        return false;
+    if (!__ldrexb(&initialized)) {
+        LightLock_Init(&g_InitLock);
+        CondVar_Init(&g_InitCond);
+
+        while (__strexb(&initialized, 1))
+            __ldrexb(&initialized);
+    } else {
+        __clrex();
     }
+}
 
-    // Get segments.
-    const size_t numSegments = ctrdl_getELFNumSegmentsByType(&ldrData->elf, PT_LOAD);
-    if (!numSegments) {
-        ctrdl_setLastError(Err_InvalidObject);
-        ctrdl_unloadObject(handle);
-        return false;
+static void ctrdl_runPendingInit(CTRDLHandle* handle) {
+    ctrdl_initLockLazyInit();
+    LightLock_Lock(&g_InitLock);
+
+    // Other claimants wait for initializers to complete, those running on this thread may reopen their own object.
+    while (handle->initRunning && (handle->initOwner != &g_InitToken))
+        CondVar_Wait(&g_InitCond, &g_InitLock);
+
+    // Claimed first, so that initializers are never run twice.
+    Elf32_Addr* initArray = handle->initArray;
+    const size_t numEntries = handle->numInitEntries;
+    handle->initArray = NULL;
+    handle->numInitEntries = 0;
+    if (numEntries) {
+        handle->initRunning = true;
+        handle->initOwner = &g_InitToken;
     }
 
-    Elf32_Phdr* loadSegments = malloc(numSegments *  sizeof(Elf32_Phdr));
-    if (!loadSegments) {
-        ctrdl_setLastError(Err_NoMemory);
-        ctrdl_unloadObject(handle);
+    LightLock_Unlock(&g_InitLock);
+
+    if (!numEntries)
+        return;
+
+    for (size_t i = 0; i < numEntries; ++i)
+        ctrdl_callInitFini(initArray[i]);
+
+    LightLock_Lock(&g_InitLock);
+    handle->initRunning = false;
+    handle->initOwner = NULL;
+    CondVar_Broadcast(&g_InitCond);
+    LightLock_Unlock(&g_InitLock);
+}
+
+// Small objects without text relocations may share code pages with other objects.
+static bool ctrdl_makePackLayout(LdrData* ldrData, u32 lowestAddr) {
+    CTRDLElf* elf = &ldrData->elf;
+    CTRDLPackLayout* layout = &ldrData->layout;
+
+    if (!CTRDL_PACK_MAX_SIZE || ldrData->handle->donated || ctrdl_getELFNumDynEntriesWithTag(elf, DT_TEXTREL))
         return false;
-    }
 
-    const size_t actualNumSegments = ctrdl_getELFSegmentsByType(&ldrData->elf, PT_LOAD, loadSegments, numSegments);
-    if (actualNumSegments != numSegments) {
-        ctrdl_setLastError(Err_InvalidObject);
-        ctrdl_unloadObject(handle);
-        free(loadSegments);
+    Elf32_Dyn flags;
+    if (ctrdl_getELFDynEntryWithTag(elf, DT_FLAGS, &flags) && (flags.d_un.d_val & DF_TEXTREL))
         return false;
+
+    layout->numSegments = 0;
+    layout->size = 0;
+    layout->usedSize = 0;
+    layout->imageBase = lowestAddr;
+    layout->offset = CTRDL_PACK_NOT_PLACED;
+
+    for (size_t i = 0; i < elf->header.e_phnum; ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if ((segment->p_type != PT_LOAD) || !segment->p_memsz)
+            continue;
+
+        const MemPerm perms = ctrdl_wrapPerms(segment->p_flags);
+        if ((segment->p_align > CTRL_PAGE_SIZE) || !perms || (layout->numSegments >= CTRDL_MAX_SEGMENTS))
+            return false;
+
+        CTRDLPackSegment* s = &layout->segments[layout->numSegments++];
+        s->begin = segment->p_vaddr - lowestAddr;
+        s->end = s->begin + segment->p_memsz;
+        s->perms = perms;
+
+        if (s->end > layout->size)
+            layout->size = s->end;
+
+        layout->usedSize += segment->p_memsz;
     }
 
+    if (!layout->numSegments || (layout->size > CTRDL_PACK_MAX_SIZE))
+        return false;
+
+    // Objects are placed at CTRDL_PACK_ALIGN boundaries, segment alignment only describes the file layout.
+    const size_t align = ctrdl_getELFAllocAlign(ldrData->stream, elf);
+    return align && (align <= CTRDL_PACK_ALIGN);
+}
+
+static bool ctrdl_mapObject(LdrData* ldrData);
+
+// Safe to run on a worker, only touches this object.
+static bool ctrdl_prepareObject(LdrData* ldrData) {
+    CTRDLHandle* handle = ldrData->handle;
+    CTRDLElf* elf = &ldrData->elf;
+
+    CTRDL_STATS_BEGIN(parseTick);
+    const bool parsed = ctrdl_parseELF(ldrData->stream, elf);
+    CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_PARSE, parseTick);
+    if (!parsed)
+        return false;
+
     // Calculate allocation size, we assume segments are contiguous and non-overlapping.
     u32 lowestAddr = -1;
     size_t highestAddr = 0;
+    size_t numSegments = 0;
 
-    for (size_t i = 0; i < numSegments; ++i) {
-        const Elf32_Phdr* segment = &loadSegments[i];
+    for (size_t i = 0; i < elf->header.e_phnum; ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if (segment->p_type != PT_LOAD)
+            continue;
 
         if (segment->p_memsz < segment->p_filesz) {
             ctrdl_setLastError(Err_InvalidObject);
-            ctrdl_unloadObject(handle);
-            free(loadSegments);
             return false;
         }
 
@@ -173,68 +502,183 @@ static bool ctrdl_mapObject(LdrData* ldrData) {
 
         if (virtualEnd > highestAddr)
             highestAddr = virtualEnd;
+
+        ++numSegments;
     }
 
-    if (highestAddr <= lowestAddr) {
+    if (!numSegments || (highestAddr <= lowestAddr)) {
         ctrdl_setLastError(Err_InvalidObject);
-        ctrdl_unloadObject(handle);
-        free(loadSegments);
         return false;
     }
 
     handle->numPages = ctrlSizeToNumPages(highestAddr - lowestAddr);
+    handle->size = ctrlNumPagesToSize(handle->numPages);
     
     // Allocate memory and map segments.
-    if (R_FAILED(ctrlAllocCodePages(handle->numPages, &handle->origin))) {
-        ctrdl_setLastError(Err_NoMemory);
-        ctrdl_unloadObject(handle);
-        free(loadSegments);
+    handle->origin = ctrdl_adoptDonatedBuffer(ldrData, lowestAddr);
+    handle->donated = handle->origin != 0;
+
+    // Small objects are placed along with the others once the graph is complete.
+    ldrData->packed = ctrdl_makePackLayout(ldrData, lowestAddr);
+    if (ldrData->packed)
+        return true;
+
+    return ctrdl_mapObject(ldrData);
+}
+
+// Reads segments and binds tables, code pages are allocated unless the object was placed in a shared region.
+static bool ctrdl_mapObject(LdrData* ldrData) {
+    CTRDLHandle* handle = ldrData->handle;
+    CTRDLElf* elf = &ldrData->elf;
+
+    if (!handle->donated && !handle->region) {
+        // The code allocator is shared with other workers.
+        CTRDL_STATS_BEGIN(tick);
+        ctrdl_acquireHandleMtx();
+        const Result res = ctrlAllocCodePages(handle->numPages, &handle->origin);
+        ctrdl_releaseHandleMtx();
+        CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_ALLOC, tick);
+
+        if (R_FAILED(res)) {
+            ctrdl_setLastError(Err_NoMemory);
+            return false;
+        }
+    }
+
+    // Segments are read in a single pass, writable ones may be left to the finish stage.
+    ldrData->pipelined = ctrdl_planPipeline(ldrData);
+    if (!handle->donated && !ctrdl_readSegments(ldrData, true, !ldrData->pipelined))
         return false;
+
+    // Donated buffers still hold file data past each segment.
+    for (size_t i = 0; handle->donated && (i < elf->header.e_phnum); ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if (segment->p_type == PT_LOAD)
+            memset((void*)(handle->origin + segment->p_vaddr + segment->p_filesz), 0, segment->p_memsz - segment->p_filesz);
+    }
+
+    // Tables are only accessible through the origin until the image is committed.
+    bool bound = ctrdl_bindELFTables(elf, handle->origin);
+    if (ldrData->pipelined && (!bound || (ctrdl_getELFTablesEnd(elf) > ldrData->writableBegin))) {
+        // Tables reach into writable data, read it now.
+        ldrData->pipelined = false;
+        if (!ctrdl_readSegments(ldrData, false, true))
+            return false;
+
+        bound = ctrdl_bindELFTables(elf, handle->origin);
     }
 
-    for (size_t i = 0; i < numSegments; ++i) {
-        const Elf32_Phdr* segment = &loadSegments[i];
+    if (!bound)
+        return false;
+
+    return true;
+}
+
+// Packed objects are interleaved with others, only their segments belong to them.
+static bool ctrdl_publishObject(LdrData* ldrData) {
+    CTRDLHandle* handle = ldrData->handle;
+    const CTRDLPackLayout* layout = &ldrData->layout;
+    bool success = true;
+
+    ctrdl_acquireHandleMtx();
 
-        if (!ldrData->stream->seek(ldrData->stream, segment->p_offset)) {
-            ctrdl_setLastError(Err_ReadFailed);
-            ctrdl_unloadObject(handle);
-            free(loadSegments);
+    if (handle->region) {
+        const u32 imageBase = handle->base + layout->imageBase;
+        for (size_t i = 0; success && (i < layout->numSegments); ++i)
+            success = ctrdl_unsafeInsertAddrRange(handle, imageBase + layout->segments[i].begin, imageBase + layout->segments[i].end);
+    } else {
+        success = ctrdl_unsafeInsertAddrRange(handle, handle->base, handle->base + handle->size);
+    }
+
+    if (success) {
+        ctrdl_unsafePublishHandle(handle);
+    } else {
+        ctrdl_unsafeUnpublishHandle(handle);
+    }
+
+    ctrdl_releaseHandleMtx();
+    return success;
+}
+
+// Runs on the loading thread, dependencies are finished first.
+static bool ctrdl_finishObject(LdrData* ldrData) {
+    CTRDLHandle* handle = ldrData->handle;
+    CTRDLElf* elf = &ldrData->elf;
+    CTRDL_STATS_BEGIN(commitTick);
+
+    if (handle->region) {
+        // Shared regions are committed by the first object to finish.
+        ctrdl_acquireHandleMtx();
+        const bool committed = ctrdl_commitRegion(handle->region);
+        ctrdl_releaseHandleMtx();
+
+        if (!committed) {
+            ctrdl_setLastError(Err_MapFailed);
             return false;
         }
 
-        if (!ldrData->stream->read(ldrData->stream, (void*)(handle->origin + segment->p_vaddr), segment->p_filesz)) {
-            ctrdl_setLastError(Err_ReadFailed);
-            ctrdl_unloadObject(handle);
-            free(loadSegments);
+        handle->base = handle->region->base + (handle->origin - handle->region->origin);
+        CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_ALLOC, commitTick);
+    } else {
+        ctrdl_acquireHandleMtx();
+        const Result res = ctrlCommitCodePages(handle->origin, handle->numPages, &handle->base);
+        ctrdl_releaseHandleMtx();
+        CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_ALLOC, commitTick);
+
+        if (R_FAILED(res)) {
+            ctrdl_setLastError(Err_MapFailed);
             return false;
         }
-    }
 
-    if (R_FAILED(ctrlCommitCodePages(handle->origin, handle->numPages, &handle->base))) {
-        ctrdl_setLastError(Err_MapFailed);
-        ctrdl_unloadObject(handle);
-        free(loadSegments);
-        return false;
+        CTRDL_STATS_BEGIN(permsTick);
+        const Result permsRes = ctrlChangeMemoryPerms(handle->base, ctrlNumPagesToSize(handle->numPages), MEMPERM_READWRITE);
+        CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_PROTECT, permsTick);
+
+        if (R_FAILED(permsRes)) {
+            ctrdl_setLastError(Err_MapFailed);
+            return false;
+        }
     }
 
-    if (R_FAILED(ctrlChangeMemoryPerms(handle->base, ctrlNumPagesToSize(handle->numPages), MEMPERM_READWRITE))) {
-        ctrdl_setLastError(Err_MapFailed);
-        ctrdl_unloadObject(handle);
-        free(loadSegments);
+    // The donated buffer is only accessible through the mirror from now on.
+    if (handle->donated)
+        ctrdl_rebaseDonatedELF(ldrData);
+
+    ctrdl_bindELFTables(elf, handle->base);
+
+    // Dependencies are final, lookups go through the flattened scopes from now on.
+    CTRDLScopes* scopes = ctrdl_makeScopes(handle);
+    if (!scopes) {
+        ctrdl_setLastError(Err_NoMemory);
         return false;
     }
 
+    __atomic_store_n(&handle->scopes, scopes, __ATOMIC_RELEASE);
+
     // Apply relocations.
-    if (!ctrdl_handleRelocs(handle, &ldrData->elf, ldrData->resolver, ldrData->resolverUserData)) {
+    CTRDL_STATS_BEGIN(relocTick);
+    if (ldrData->pipelined) {
+        if (!ctrdl_pipelineRelocs(ldrData))
+            return false;
+    } else if (!ctrdl_handleRelocs(handle, elf, ldrData->resolver, ldrData->resolverUserData)) {
         ctrdl_setLastError(Err_RelocFailed);
-        ctrdl_unloadObject(handle);
-        free(loadSegments);
         return false;
     }
 
+    CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_RELOC, relocTick);
+
     // Set correct permissions.
-    for (size_t i = 0; i < numSegments; ++i) {
-        const Elf32_Phdr* segment = &loadSegments[i];
+    CTRDL_STATS_BEGIN(protectTick);
+    if (handle->region && !ctrdl_protectRegion(handle->region, &ldrData->layout)) {
+        ctrdl_setLastError(Err_MapFailed);
+        return false;
+    }
+
+    for (size_t i = 0; !handle->region && (i < elf->header.e_phnum); ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if (segment->p_type != PT_LOAD)
+            continue;
+
         const u32 base = handle->base + segment->p_vaddr;
 
         size_t alignedSize = segment->p_memsz;
@@ -245,86 +689,682 @@ static bool ctrdl_mapObject(LdrData* ldrData) {
 
         if (R_FAILED(ctrlChangeMemoryPerms(base, alignedSize, perms))) {
             ctrdl_setLastError(Err_MapFailed);
-            ctrdl_unloadObject(handle);
-            free(loadSegments);
             return false;
         }
     }
 
+    CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_PROTECT, protectTick);
+
+    CTRDL_STATS_BEGIN(cacheTick);
     ctrlFlushDataCache();
     ctrlInvalidateInstructionCache();
-    free(loadSegments);
+    CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_CACHE, cacheTick);
+
+    // Symbol tables are referenced in the mapped image, initializers may already go through lazy slots.
+    handle->symTable = elf->symTable;
 
-    // Run initializers.
+    // Pending before the object can be found, so that whoever reopens it first runs them.
     Elf32_Dyn initEntry;
-    const bool hasInitArr = ctrdl_getELFDynEntryWithTag(&ldrData->elf, DT_INIT_ARRAY, &initEntry);
+    const bool hasInitArr = ctrdl_getELFDynEntryWithTag(elf, DT_INIT_ARRAY, &initEntry);
 
     Elf32_Dyn initEntrySize;
-    const bool hasInitSz = ctrdl_getELFDynEntryWithTag(&ldrData->elf, DT_INIT_ARRAYSZ, &initEntrySize);
+    const bool hasInitSz = ctrdl_getELFDynEntryWithTag(elf, DT_INIT_ARRAYSZ, &initEntrySize);
 
     if (hasInitArr && hasInitSz) {
-        const Elf32_Addr* initArray = (const Elf32_Addr*)(handle->base + initEntry.d_un.d_ptr);
-        const size_t numEntries = initEntrySize.d_un.d_val / sizeof(Elf32_Addr);
-        for (size_t i = 0; i < numEntries; ++i)
-            ctrdl_callInitFini(initArray[i]);
+        handle->initArray = (Elf32_Addr*)(handle->base + initEntry.d_un.d_ptr);
+        handle->numInitEntries = initEntrySize.d_un.d_val / sizeof(Elf32_Addr);
     }
 
     // Fill additional data.
     Elf32_Dyn finiEntry;
-    const bool hasFiniArr = ctrdl_getELFDynEntryWithTag(&ldrData->elf, DT_FINI_ARRAY, &finiEntry);
+    const bool hasFiniArr = ctrdl_getELFDynEntryWithTag(elf, DT_FINI_ARRAY, &finiEntry);
 
     Elf32_Dyn finiEntrySize;
-    const bool hasFiniSz = ctrdl_getELFDynEntryWithTag(&ldrData->elf, DT_FINI_ARRAYSZ, &finiEntrySize);
+    const bool hasFiniSz = ctrdl_getELFDynEntryWithTag(elf, DT_FINI_ARRAYSZ, &finiEntrySize);
 
     if (hasFiniArr && hasFiniSz) {
         handle->finiArray = (Elf32_Addr*)(handle->base + finiEntry.d_un.d_ptr);
         handle->numFiniEntries = finiEntrySize.d_un.d_val / sizeof(Elf32_Addr);
     }
 
-    handle->numSymBuckets = ldrData->elf.numSymBuckets;
-    handle->symBuckets = ldrData->elf.symBuckets;
-    handle->numSymChains = ldrData->elf.numSymChains;
-    handle->symChains = ldrData->elf.symChains;
-    handle->symEntries = ldrData->elf.symEntries;
-    handle->stringTable = ldrData->elf.stringTable;
-    ldrData->elf.symBuckets = NULL;
-    ldrData->elf.symChains = NULL;
-    ldrData->elf.symEntries = NULL;
-    ldrData->elf.stringTable = NULL;
     return true;
 }
 
-CTRDLHandle* ctrdl_loadObject(const char* name, int flags, CTRDLStream* stream, CTRDLResolverFn resolver, void* resolverUserData) {
-    LdrData ldrData;
-    ldrData.handle = ctrdl_createHandle(name, flags);
-    if (!ldrData.handle)
+static void ctrdl_prepareJob(void* arg) {
+    LdrNode* node = (LdrNode*)arg;
+
+    // Dependencies are opened here, so that their reads overlap.
+    if (!node->data.stream) {
+        CTRDL_STATS_BEGIN(tick);
+        node->file = fopen(node->data.handle->path, "rb");
+        CTRDL_STATS_END(&node->data.handle->loadStats, CTRDL_PHASE_OPEN, tick);
+        if (!node->file) {
+            node->error = Err_NotFound;
+            return;
+        }
+
+        ctrdl_makeFileStream(&node->fileStream, node->file);
+        node->data.stream = &node->fileStream;
+    }
+
+    node->numSeeks = node->data.stream->numSeeks;
+    node->numReads = node->data.stream->numReads;
+#ifdef CTRDL_LOAD_STATS
+    node->bytesRead = node->data.stream->bytesRead;
+#endif // CTRDL_LOAD_STATS
+
+    ctrdl_clearLastError();
+    node->ready = ctrdl_prepareObject(&node->data);
+    node->error = node->ready ? Err_OK : ctrdl_getLastError();
+}
+
+static LdrNode* ctrdl_createNode(LdrGraph* graph, const char* path, u32 pathHash, int flags) {
+    if (graph->numNodes >= graph->maxNodes) {
+        const size_t maxNodes = graph->maxNodes ? (graph->maxNodes * 2) : 8;
+        void* p = realloc(graph->nodes, maxNodes * sizeof(LdrNode*));
+        if (!p) {
+            ctrdl_setLastError(Err_NoMemory);
+            return NULL;
+        }
+
+        graph->nodes = p;
+        graph->maxNodes = maxNodes;
+    }
+
+    LdrNode* node = calloc(1, sizeof(LdrNode));
+    if (!node) {
+        ctrdl_setLastError(Err_NoMemory);
+        return NULL;
+    }
+
+    node->data.handle = ctrdl_createHandle(path, pathHash, flags);
+    if (!node->data.handle) {
+        free(node);
+        return NULL;
+    }
+
+    ctrdl_planInit(&node->data.plan);
+    node->data.resolver = graph->resolver;
+    node->data.resolverUserData = graph->resolverUserData;
+    node->data.deferInit = graph->options && graph->options->deferInit;
+    graph->nodes[graph->numNodes++] = node;
+    return node;
+}
+
+static LdrNode* ctrdl_findNode(LdrGraph* graph, CTRDLHandle* handle) {
+    for (size_t i = 0; i < graph->numNodes; ++i) {
+        if (graph->nodes[i]->data.handle == handle)
+            return graph->nodes[i];
+    }
+
+    return NULL;
+}
+
+// Threads waiting for the object give up, it's no longer found by name.
+static inline void ctrdl_failNode(LdrNode* node, CTRDLError error) { ctrdl_failHandle(node->data.handle, error); }
+
+// Failed dependencies are only tolerated when the user can resolve references.
+static inline bool ctrdl_skipDep(LdrGraph* graph, CTRDLError error) {
+    if (!graph->resolver) {
+        ctrdl_setLastError(error);
+        return false;
+    }
+
+    return true;
+}
+
+static bool ctrdl_expandNode(LdrGraph* graph, LdrNode* node) {
+    CTRDLElf* elf = &node->data.elf;
+    CTRDLHandle* handle = node->data.handle;
+
+    const size_t depCount = ctrdl_getELFNumDynEntriesWithTag(elf, DT_NEEDED);
+    if (!depCount)
+        return true;
+
+    // Entries of missing dependencies stay NULL.
+    Elf32_Dyn* depEntries = malloc(depCount * sizeof(Elf32_Dyn));
+    handle->deps = calloc(depCount, sizeof(CTRDLHandle*));
+    node->deps = calloc(depCount, sizeof(LdrNode*));
+    if (!depEntries || !handle->deps || !node->deps) {
+        free(depEntries);
+        ctrdl_setLastError(Err_NoMemory);
+        return false;
+    }
+
+    handle->numDeps = depCount;
+
+    const size_t actualDepCount = ctrdl_getELFDynEntriesWithTag(elf, DT_NEEDED, depEntries, depCount);
+    if (actualDepCount != depCount) {
+        free(depEntries);
+        return ctrdl_skipDep(graph, Err_DepFailed);
+    }
+
+    const bool local = handle->flags & RTLD_LOCAL;
+    const int depFlags = (handle->flags & (RTLD_LAZY | RTLD_NOW)) | (local ? RTLD_LOCAL : RTLD_GLOBAL);
+
+    for (size_t i = 0; i < depCount; ++i) {
+        // Packed objects are mapped once the graph is complete, their names are read from the stream.
+        const Elf32_Word nameOffset = depEntries[i].d_un.d_val;
+        const char* name = elf->symTable.stringTable ? (elf->symTable.stringTable + nameOffset) : NULL;
+        char* nameCopy = name ? NULL : ctrdl_readELFString(node->data.stream, elf, nameOffset);
+        char* relPath = ctrdl_getDepPath(handle->path, name ? name : nameCopy);
+        free(nameCopy);
+
+        // Paths are canonicalized once, for both the lookup and the new handle.
+        char* depPath = relPath ? ctrdl_canonicalizePath(relPath) : NULL;
+        free(relPath);
+        if (!depPath) {
+            if (!ctrdl_skipDep(graph, Err_DepFailed)) {
+                free(depEntries);
+                return false;
+            }
+
+            continue;
+        }
+
+        // Objects already open, or already part of this load, are shared; those of other loads are only shared once published.
+        const u32 depHash = ctrdl_hashPath(depPath);
+        bool found;
+        CTRDLHandle* dep = ctrdl_reopenHandle(depPath, depHash, depFlags, &graph->load, &found);
+        if (dep) {
+            handle->deps[i] = dep;
+            node->deps[i] = ctrdl_findNode(graph, dep);
+        } else if (found) {
+            // The other load failed, or would wait on this one.
+            if (!ctrdl_skipDep(graph, Err_DepFailed)) {
+                free(depPath);
+                free(depEntries);
+                return false;
+            }
+        } else {
+            LdrNode* depNode = ctrdl_createNode(graph, depPath, depHash, depFlags);
+            if (depNode) {
+                handle->deps[i] = depNode->data.handle;
+                node->deps[i] = depNode;
+                ctrdl_jobSubmit(&graph->group, &depNode->job, ctrdl_prepareJob, depNode);
+            } else if (!ctrdl_skipDep(graph, Err_DepFailed)) {
+                free(depPath);
+                free(depEntries);
+                return false;
+            }
+        }
+
+        free(depPath);
+    }
+
+    free(depEntries);
+    return true;
+}
+
+// Dependencies come before their dependents, cycles are broken at the back edge.
+static size_t ctrdl_sortGraph(LdrGraph* graph, LdrNode** order, LdrNode** stack) {
+    size_t stackSize = 0;
+    size_t count = 0;
+
+    stack[stackSize++] = graph->nodes[0];
+    graph->nodes[0]->visit = VISIT_ACTIVE;
+
+    while (stackSize) {
+        LdrNode* node = stack[stackSize - 1];
+        if (node->nextDep < node->data.handle->numDeps) {
+            LdrNode* dep = node->deps[node->nextDep++];
+            if (dep && (dep->visit == VISIT_NONE)) {
+                dep->visit = VISIT_ACTIVE;
+                stack[stackSize++] = dep;
+            }
+        } else {
+            node->visit = VISIT_DONE;
+            order[count++] = node;
+            --stackSize;
+        }
+    }
+
+    return count;
+}
+
+// Objects finished earlier in a cycle may reach detached dependencies, their scopes are rebuilt.
+static bool ctrdl_rebuildScopes(LdrGraph* graph) {
+    CTRDLScopes** scopes = malloc(graph->numNodes * sizeof(CTRDLScopes*));
+    if (!scopes)
+        return false;
+
+    for (size_t i = 0; i < graph->numNodes; ++i) {
+        CTRDLHandle* handle = graph->nodes[i]->data.handle;
+        scopes[i] = NULL;
+        if (!handle->scopes)
+            continue;
+
+        scopes[i] = ctrdl_makeScopes(handle);
+        if (!scopes[i]) {
+            for (size_t j = 0; j < i; ++j)
+                free(scopes[j]);
+
+            free(scopes);
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < graph->numNodes; ++i) {
+        if (scopes[i])
+            scopes[i] = __atomic_exchange_n(&graph->nodes[i]->data.handle->scopes, scopes[i], __ATOMIC_ACQ_REL);
+    }
+
+    // Lookups may still be walking the replaced scopes.
+    ctrdl_acquireHandleMtx();
+    ctrdl_unsafeWaitForReaders();
+    ctrdl_releaseHandleMtx();
+
+    for (size_t i = 0; i < graph->numNodes; ++i)
+        free(scopes[i]);
+
+    free(scopes);
+    return true;
+}
+
+static void ctrdl_finishNode(LdrGraph* graph, LdrNode* node) {
+    CTRDLHandle* handle = node->data.handle;
+    bool anyDetached = false;
+
+    for (size_t i = 0; i < handle->numDeps; ++i) {
+        LdrNode* dep = node->deps[i];
+        if (!dep || dep->ready)
+            continue;
+
+        // Detach dependencies that could not be loaded.
+        if (!ctrdl_skipDep(graph, Err_DepFailed)) {
+            node->ready = false;
+            node->error = Err_DepFailed;
+            return;
+        }
+
+        handle->deps[i] = NULL;
+        anyDetached = true;
+    }
+
+    // Detached dependencies stay loaded until no scope references them.
+    if (anyDetached && !ctrdl_rebuildScopes(graph)) {
+        for (size_t i = 0; i < handle->numDeps; ++i) {
+            if (node->deps[i] && !node->deps[i]->ready)
+                handle->deps[i] = node->deps[i]->data.handle;
+        }
+
+        node->ready = false;
+        node->error = Err_NoMemory;
+        return;
+    }
+
+    for (size_t i = 0; i < handle->numDeps; ++i) {
+        if (node->deps[i] && !node->deps[i]->ready) {
+            ctrdl_unlockHandle(node->deps[i]->data.handle);
+            node->deps[i] = NULL;
+        }
+    }
+
+    ctrdl_clearLastError();
+    node->ready = ctrdl_finishObject(&node->data);
+    node->error = node->ready ? Err_OK : ctrdl_getLastError();
+    if (!node->ready)
+        return;
+
+    // Counters are final before lookups can find the object.
+    handle->numSeeks = node->data.stream->numSeeks - node->numSeeks;
+    handle->numReads = node->data.stream->numReads - node->numReads;
+    handle->numAllocs = node->data.elf.numAllocs;
+
+#ifdef CTRDL_LOAD_STATS
+    CTRDLLoadStats* stats = &handle->loadStats;
+    stats->numObjects = 1;
+    stats->bytesRead = node->data.stream->bytesRead - node->bytesRead;
+    stats->bytesMapped = handle->region ? handle->packedSize : handle->size;
+    stats->numRelocs = handle->numRelocs;
+#endif // CTRDL_LOAD_STATS
+
+    // Lookups see complete objects only, initializers may already look up their own.
+    if (!ctrdl_publishObject(&node->data)) {
+        node->ready = false;
+        node->error = Err_NoMemory;
+        return;
+    }
+
+    // Dependencies left uninitialized by earlier deferred loads are initialized first.
+    if (!node->data.deferInit) {
+        CTRDL_STATS_BEGIN(initTick);
+        ctrdl_runInitializers(handle);
+        CTRDL_STATS_END(&handle->loadStats, CTRDL_PHASE_INIT, initTick);
+    }
+
+#ifdef CTRDL_LOAD_STATS
+    stats->totalTicks = svcGetSystemTick() - graph->startTick;
+#endif // CTRDL_LOAD_STATS
+}
+
+static void ctrdl_mapJob(void* arg) {
+    LdrNode* node = (LdrNode*)arg;
+    ctrdl_clearLastError();
+    node->ready = ctrdl_mapObject(&node->data);
+    node->error = node->ready ? Err_OK : ctrdl_getLastError();
+}
+
+// Small objects of the same graph share code pages, committed pages can't be shared with later loads.
+static void ctrdl_packGraph(LdrGraph* graph) {
+    size_t numLayouts = 0;
+    for (size_t i = 0; i < graph->numNodes; ++i) {
+        if (graph->nodes[i]->ready && graph->nodes[i]->data.packed)
+            ++numLayouts;
+    }
+
+    if (!numLayouts)
+        return;
+
+    // A single object has nothing to share pages with, nor do objects if there's no memory to plan with.
+    CTRDLCodeRegion* region = NULL;
+    CTRDLPackLayout** layouts = (numLayouts > 1) ? malloc(numLayouts * sizeof(CTRDLPackLayout*)) : NULL;
+    if (layouts) {
+        numLayouts = 0;
+        for (size_t i = 0; i < graph->numNodes; ++i) {
+            LdrData* data = &graph->nodes[i]->data;
+            if (graph->nodes[i]->ready && data->packed)
+                layouts[numLayouts++] = &data->layout;
+        }
+
+        CTRDL_STATS_BEGIN(tick);
+        ctrdl_acquireHandleMtx();
+        region = ctrdl_packObjects(layouts, numLayouts);
+        ctrdl_releaseHandleMtx();
+        CTRDL_STATS_END(&graph->stats, CTRDL_PHASE_ALLOC, tick);
+        free(layouts);
+    }
+
+    for (size_t i = 0; i < graph->numNodes; ++i) {
+        LdrNode* node = graph->nodes[i];
+        LdrData* data = &node->data;
+        if (!node->ready || !data->packed)
+            continue;
+
+        // Objects which could not be placed get their own pages.
+        CTRDLHandle* handle = data->handle;
+        if (region && (data->layout.offset != CTRDL_PACK_NOT_PLACED)) {
+            handle->region = region;
+            handle->origin = region->origin + data->layout.offset - data->layout.imageBase;
+            handle->size = data->layout.size;
+            handle->packedSize = data->layout.usedSize;
+        } else {
+            data->packed = false;
+        }
+
+        ctrdl_jobSubmit(&graph->group, &node->job, ctrdl_mapJob, node);
+    }
+
+    // Failures are handled while finishing.
+    while (ctrdl_jobGroupWait(&graph->group))
+        ;
+}
+
+static inline bool ctrdl_isCancelled(const LdrGraph* graph) {
+    return graph->options && graph->options->cancelled && *graph->options->cancelled;
+}
+
+static void ctrdl_destroyGraph(LdrGraph* graph) {
+    for (size_t i = 0; i < graph->numNodes; ++i) {
+        LdrNode* node = graph->nodes[i];
+        ctrdl_freeELF(&node->data.elf);
+
+        if (node->file)
+            fclose(node->file);
+
+        free(node->deps);
+        free(node);
+    }
+
+    free(graph->nodes);
+    graph->nodes = NULL;
+    graph->numNodes = 0;
+    graph->maxNodes = 0;
+}
+
+#ifdef CTRDL_LOAD_STATS
+// Objects of failed loads are summed as well, but only finished ones are counted.
+static void ctrdl_reportLoadStats(LdrGraph* graph, CTRDLHandle* handle) {
+    ctrdl_acquireHandleMtx();
+    const CTRDLLoadStatsCallback callback = g_LoadStatsCallback;
+    void* userData = g_LoadStatsUserData;
+    ctrdl_releaseHandleMtx();
+
+    if (!callback)
+        return;
+
+    CTRDLLoadStats* total = &graph->stats;
+    for (size_t i = 0; i < graph->numNodes; ++i) {
+        const CTRDLLoadStats* stats = &graph->nodes[i]->data.handle->loadStats;
+        for (size_t j = 0; j < CTRDL_NUM_PHASES; ++j)
+            total->ticks[j] += stats->ticks[j];
+
+        for (size_t j = 0; j < CTRDL_NUM_SCOPES; ++j)
+            total->numResolved[j] += stats->numResolved[j];
+
+        total->numObjects += stats->numObjects;
+        total->bytesRead += stats->bytesRead;
+        total->bytesMapped += stats->bytesMapped;
+        total->numRelocs += stats->numRelocs;
+    }
+
+    total->totalTicks = svcGetSystemTick() - graph->startTick;
+    callback(handle ? ctrdl_getHandleId(handle) : NULL, total, userData);
+}
+#endif // CTRDL_LOAD_STATS
+
+CTRDLHandle* ctrdl_loadObject(const char* path, u32 pathHash, int flags, CTRDLStream* stream, CTRDLResolverFn resolver, void* resolverUserData, const CTRDLLoadOptions* options) {
+    LdrGraph graph;
+    graph.nodes = NULL;
+    graph.numNodes = 0;
+    graph.maxNodes = 0;
+    graph.resolver = resolver;
+    graph.resolverUserData = resolverUserData;
+    graph.options = options;
+#ifdef CTRDL_LOAD_STATS
+    graph.startTick = svcGetSystemTick();
+    memset(&graph.stats, 0, sizeof(CTRDLLoadStats));
+#endif // CTRDL_LOAD_STATS
+    ctrdl_jobGroupInit(&graph.group);
+    ctrdl_beginLoad(&graph.load);
+
+    LdrNode* root = ctrdl_createNode(&graph, path, pathHash, flags);
+    if (!root) {
+        ctrdl_destroyGraph(&graph);
+        ctrdl_endLoad(&graph.load);
         return NULL;
+    }
+
+    root->data.stream = stream;
+    ctrdl_jobSubmit(&graph.group, &root->job, ctrdl_prepareJob, root);
+
+    // Build the graph as objects are prepared, all jobs must complete before cleaning up.
+    bool success = true;
+    CTRDLError error = Err_OK;
+    CTRDLJob* job;
+
+    while ((job = ctrdl_jobGroupWait(&graph.group))) {
+        LdrNode* node = (LdrNode*)job->arg;
+        if (success && ctrdl_isCancelled(&graph)) {
+            success = false;
+            error = Err_Cancelled;
+        }
+
+        if (!success)
+            continue;
+
+        if (!node->ready) {
+            if ((node == root) || !ctrdl_skipDep(&graph, node->error)) {
+                success = false;
+                error = (node == root) ? node->error : Err_DepFailed;
+            }
+
+            continue;
+        }
+
+        CTRDL_STATS_BEGIN(tick);
+        const bool expanded = ctrdl_expandNode(&graph, node);
+        CTRDL_STATS_END(&node->data.handle->loadStats, CTRDL_PHASE_DEPS, tick);
+
+        if (!expanded) {
+            success = false;
+            error = ctrdl_getLastError();
+        }
+    }
+
+    if (success)
+        ctrdl_packGraph(&graph);
 
-    if (!ctrdl_parseELF(stream, &ldrData.elf)) {
-        ctrdl_unlockHandle(ldrData.handle);
+    // Objects are failed before dependents may release them.
+    for (size_t i = 0; i < graph.numNodes; ++i) {
+        if (!graph.nodes[i]->ready)
+            ctrdl_failNode(graph.nodes[i], graph.nodes[i]->error);
+    }
+
+    // Relocations and initializers run in dependency order on this thread.
+    LdrNode** order = success ? malloc(2 * graph.numNodes * sizeof(LdrNode*)) : NULL;
+    if (success && !order) {
+        success = false;
+        error = Err_NoMemory;
+    }
+
+    if (success) {
+        const size_t count = ctrdl_sortGraph(&graph, order, &order[graph.numNodes]);
+
+        for (size_t i = 0; i < count; ++i) {
+            if (ctrdl_isCancelled(&graph)) {
+                root->ready = false;
+                root->error = Err_Cancelled;
+                break;
+            }
+
+            if (order[i]->ready) {
+                ctrdl_finishNode(&graph, order[i]);
+                if (!order[i]->ready)
+                    ctrdl_failNode(order[i], order[i]->error);
+            }
+        }
+
+        success = root->ready;
+        error = root->error;
+    }
+
+    free(order);
+
+    // Dependencies are released along with the root.
+    CTRDLHandle* handle = root->data.handle;
+#ifdef CTRDL_LOAD_STATS
+    ctrdl_reportLoadStats(&graph, success ? handle : NULL);
+#endif // CTRDL_LOAD_STATS
+
+    if (!success) {
+        // Objects left unfinished are still referenced by the graph.
+        for (size_t i = 0; i < graph.numNodes; ++i) {
+            if (graph.nodes[i]->ready || (graph.nodes[i] == root))
+                ctrdl_failNode(graph.nodes[i], error);
+        }
+
+        // Ownership of donated buffers is only taken on success.
+        handle->flags &= ~CTRDL_MAP_DONATE;
+        ctrdl_unlockHandle(handle);
+        handle = NULL;
+        ctrdl_setLastError(error);
+    }
+
+    ctrdl_destroyGraph(&graph);
+    ctrdl_endLoad(&graph.load);
+    return handle;
+}
+
+CTRDLHandle* ctrdl_openObject(const char* path, int flags, CTRDLResolverFn resolver, void* resolverUserData, const CTRDLLoadOptions* options) {
+    // Paths are canonicalized once, for both the lookup and the new handle.
+    char* canonPath = ctrdl_canonicalizePath(path);
+    if (!canonPath) {
+        ctrdl_setLastError(Err_NoMemory);
         return NULL;
     }
 
-    ldrData.stream = stream;
-    ldrData.resolver = resolver;
-    ldrData.resolverUserData = resolverUserData;
-    if (!ctrdl_mapObject(&ldrData)) {
-        ctrdl_unlockHandle(ldrData.handle);
-        ldrData.handle = NULL;
+    const u32 pathHash = ctrdl_hashPath(canonPath);
+
+    // Avoid reading if already open, objects left uninitialized by deferred loads are initialized now.
+    // Objects being loaded by other threads are waited for, their failure is not retried.
+    bool found;
+    CTRDLHandle* handle = ctrdl_reopenHandle(canonPath, pathHash, flags, NULL, &found);
+    if (found) {
+        if (handle && (!options || !options->deferInit))
+            ctrdl_runInitializers(handle);
+    } else if (flags & RTLD_NOLOAD) {
+        ctrdl_setLastError(Err_NotFound);
+    } else {
+        // Open file for reading.
+        FILE* f = fopen(path, "rb");
+        if (f) {
+            CTRDLStream stream;
+            ctrdl_makeFileStream(&stream, f);
+            handle = ctrdl_loadObject(canonPath, pathHash, flags, &stream, resolver, resolverUserData, options);
+            fclose(f);
+        } else {
+            ctrdl_setLastError(Err_NotFound);
+        }
     }
 
-    ctrdl_freeELF(&ldrData.elf);
-    return ldrData.handle;
+    free(canonPath);
+    return handle;
+}
+
+void ctrdl_runInitializers(CTRDLHandle* handle) {
+    // Scopes may be rebuilt while a cycle is loading, each object is picked and locked within a read; dependencies are initialized first.
+    for (size_t i = 0;; ++i) {
+        u32 phase;
+        ctrdl_beginRead(&phase);
+
+        CTRDLHandle* h = NULL;
+        const CTRDLScopes* scopes = __atomic_load_n(&handle->scopes, __ATOMIC_ACQUIRE);
+        if (scopes) {
+            if (i < scopes->size)
+                h = scopes->handles[2 * scopes->size + i];
+        } else if (!i) {
+            h = handle;
+        }
+
+        ctrdl_lockHandle(h);
+        ctrdl_endRead(phase);
+
+        if (!h)
+            break;
+
+        ctrdl_runPendingInit(h);
+        ctrdl_unlockHandle(h);
+    }
 }
 
 bool ctrdl_unloadObject(CTRDLHandle* handle) {
+    // Objects which were never initialized are not finalized either.
+    if (handle->initArray)
+        handle->finiArray = NULL;
+
     // Run finalizers.
     if (handle->finiArray) {
         for (size_t i = 0; i < handle->numFiniEntries; ++i)
             ctrdl_callInitFini(handle->finiArray[handle->numFiniEntries - i - 1]);
     }
 
+    // Lock-free readers are done with the object once it's unpublished.
+    ctrdl_unsafeUnpublishHandle(handle);
+
     // Unmap segments.
+
+    if (handle->region) {
+        if (!ctrdl_releaseRegion(handle->region, handle->packedSize)) {
+            ctrdl_setLastError(Err_FreeFailed);
+            return false;
+        }
+
+        handle->region = NULL;
+        handle->base = 0;
+        handle->origin = 0;
+    }
+
     if (handle->base && handle->origin) {
         if (R_FAILED(ctrlReleaseCodePages(handle->origin, handle->base, handle->numPages))) {
             ctrdl_setLastError(Err_FreeFailed);
@@ -335,25 +1375,59 @@ bool ctrdl_unloadObject(CTRDLHandle* handle) {
     }
 
     if (handle->origin) {
-        if (R_FAILED(ctrlFreeCodePages(handle->origin, handle->numPages))) {
+        // Donated buffers of failed loads are left to the caller.
+        if (handle->donated) {
+            if (handle->flags & CTRDL_MAP_DONATE)
+                free((void*)handle->origin);
+        } else if (R_FAILED(ctrlFreeCodePages(handle->origin, handle->numPages))) {
             ctrdl_setLastError(Err_FreeFailed);
             return false;
         }
 
         handle->origin = 0;
-        handle->numPages = 0;
     }
 
     // Unload dependencies.
-    for (size_t i = 0; i < CTRDL_MAX_DEPS; ++i) {
-        CTRDLHandle* dep = (CTRDLHandle*)handle->deps[i];
+    for (size_t i = 0; i < handle->numDeps; ++i) {
+        CTRDLHandle* dep = handle->deps[i];
         if (dep)
             ctrdl_unlockHandle(dep);
     }
 
-    free(handle->symBuckets);
-    free(handle->symChains);
-    free(handle->symEntries);
-    free(handle->stringTable);
+    free(handle->deps);
+    handle->deps = NULL;
+    handle->numDeps = 0;
+
+    memset(&handle->symTable, 0, sizeof(CTRDLSymTable));
+    free(handle->scopes);
+    handle->scopes = NULL;
+    free(handle->symAddrs);
+    handle->symAddrs = NULL;
+    handle->numSymAddrs = 0;
+    handle->pltGot = NULL;
+    handle->jmpRel = NULL;
+    handle->numJmpRelEntries = 0;
+    handle->numPages = 0;
+    return true;
+}
+
+bool ctrdl_setLoadStatsCallback(CTRDLLoadStatsCallback callback, void* userData) {
+#ifdef CTRDL_LOAD_STATS
+    ctrdl_acquireHandleMtx();
+    g_LoadStatsCallback = callback;
+    g_LoadStatsUserData = userData;
+    ctrdl_releaseHandleMtx();
+    return true;
+#else
+    return false;
+#endif // CTRDL_LOAD_STATS
+}
+
+bool ctrdl_setPipelineChunkSize(size_t size) {
+    // Chunks end on word boundaries.
+    if (size & (sizeof(u32) - 1))
+        return false;
+
+    __atomic_store_n(&g_PipelineChunkSize, size, __ATOMIC_RELAXED);
     return true;
-}
\ No newline at end of file
+}
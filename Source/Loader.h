@@ -10,7 +10,20 @@
 #include "Handle.h"
 #include "Stream.h"
 
-CTRDLHandle* ctrdl_loadObject(const char* name, int flags, CTRDLStream* stream, CTRDLResolverFn resolver, void* resolverUserData);
+typedef struct {
+    volatile bool* cancelled; // Checked between loading stages (optional).
+    bool deferInit;           // Leave initializers to ctrdl_runInitializers.
+} CTRDLLoadOptions;
+
+// Paths are canonical, NULL for anonymous objects; options may be NULL.
+CTRDLHandle* ctrdl_loadObject(const char* path, u32 pathHash, int flags, CTRDLStream* stream, CTRDLResolverFn resolver, void* resolverUserData, const CTRDLLoadOptions* options);
+CTRDLHandle* ctrdl_openObject(const char* path, int flags, CTRDLResolverFn resolver, void* resolverUserData, const CTRDLLoadOptions* options);
+void ctrdl_runInitializers(CTRDLHandle* handle);
 bool ctrdl_unloadObject(CTRDLHandle* handle);
 
+// A size of 0 disables pipelined loading.
+bool ctrdl_setPipelineChunkSize(size_t size);
+// Fails unless built with CTRDL_LOAD_STATS, callbacks run on the loading thread.
+bool ctrdl_setLoadStatsCallback(CTRDLLoadStatsCallback callback, void* userData);
+
 #endif /* _CTRDL_LOADER_H */
\ No newline at end of file
@@ -0,0 +1,94 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ReadPlan.h"
+#include "Error.h"
+
+#include <string.h>
+
+static inline bool ctrdl_regionLess(const CTRDLReadRegion* a, const CTRDLReadRegion* b) {
+    // Larger regions go first, so that smaller ones contained in them can be copied.
+    if (a->offset != b->offset)
+        return a->offset < b->offset;
+
+    return a->size > b->size;
+}
+
+static void ctrdl_planSort(CTRDLReadPlan* plan) {
+    for (size_t i = 1; i < plan->numRegions; ++i) {
+        CTRDLReadRegion r = plan->regions[i];
+        size_t j = i;
+
+        while (j > 0 && ctrdl_regionLess(&r, &plan->regions[j - 1])) {
+            plan->regions[j] = plan->regions[j - 1];
+            --j;
+        }
+
+        plan->regions[j] = r;
+    }
+}
+
+static bool ctrdl_planSkipTo(CTRDLStream* stream, size_t offset) {
+    u8 scratch[CTRDL_PLAN_MAX_SKIP];
+
+    if ((stream->pos != CTRDL_STREAM_POS_UNKNOWN) && (stream->pos < offset) && ((offset - stream->pos) <= CTRDL_PLAN_MAX_SKIP))
+        return ctrdl_streamRead(stream, scratch, offset - stream->pos);
+
+    return ctrdl_streamSeek(stream, offset);
+}
+
+void ctrdl_planInit(CTRDLReadPlan* plan) { plan->numRegions = 0; }
+
+bool ctrdl_planAdd(CTRDLReadPlan* plan, size_t offset, size_t size, void* dst) {
+    if (!size)
+        return true;
+
+    if (plan->numRegions >= CTRDL_PLAN_MAX_REGIONS)
+        return false;
+
+    CTRDLReadRegion* r = &plan->regions[plan->numRegions++];
+    r->offset = offset;
+    r->size = size;
+    r->dst = dst;
+    return true;
+}
+
+bool ctrdl_planExecute(CTRDLReadPlan* plan, CTRDLStream* stream) {
+    ctrdl_planSort(plan);
+
+    // Region which reaches the furthest among those already filled.
+    const CTRDLReadRegion* covering = NULL;
+
+    for (size_t i = 0; i < plan->numRegions; ++i) {
+        const CTRDLReadRegion* r = &plan->regions[i];
+        const size_t end = r->offset + r->size;
+        size_t cur = r->offset;
+
+        // Copy data that was already read.
+        if (covering) {
+            const size_t coveredEnd = covering->offset + covering->size;
+            if (cur < coveredEnd) {
+                const size_t n = (end < coveredEnd ? end : coveredEnd) - cur;
+                memcpy(r->dst, (u8*)covering->dst + (cur - covering->offset), n);
+                cur += n;
+            }
+        }
+
+        // Read the rest.
+        if (cur < end) {
+            if (!ctrdl_planSkipTo(stream, cur) || !ctrdl_streamRead(stream, (u8*)r->dst + (cur - r->offset), end - cur)) {
+                ctrdl_setLastError(Err_ReadFailed);
+                return false;
+            }
+        }
+
+        if (!covering || end > (covering->offset + covering->size))
+            covering = r;
+    }
+
+    plan->numRegions = 0;
+    return true;
+}
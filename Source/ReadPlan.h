@@ -0,0 +1,32 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _CTRDL_READPLAN_H
+#define _CTRDL_READPLAN_H
+
+#include "Stream.h"
+
+#define CTRDL_PLAN_MAX_REGIONS 32
+#define CTRDL_PLAN_MAX_SKIP 0x200 // Gaps up to this size are read through rather than seeked over.
+
+typedef struct {
+    size_t offset; // Stream offset.
+    size_t size;   // Region size.
+    void* dst;     // Destination buffer.
+} CTRDLReadRegion;
+
+typedef struct {
+    CTRDLReadRegion regions[CTRDL_PLAN_MAX_REGIONS];
+    size_t numRegions;
+} CTRDLReadPlan;
+
+void ctrdl_planInit(CTRDLReadPlan* plan);
+bool ctrdl_planAdd(CTRDLReadPlan* plan, size_t offset, size_t size, void* dst);
+
+// Regions are sorted by offset and filled in a single forward pass; overlapping data is read once.
+bool ctrdl_planExecute(CTRDLReadPlan* plan, CTRDLStream* stream);
+
+#endif /* _CTRDL_READPLAN_H */
@@ -7,15 +7,58 @@
 #include "Relocs.h"
 #include "Symbol.h"
 
+#include <3ds.h>
+
+#include <stdlib.h>
 #include <string.h> // strcmp
 
+#define SYM_UNRESOLVED 0
+#define SYM_RESOLVED 1
+
 typedef struct {
     CTRDLHandle* handle;
-    CTRDLElf* elf;
+    const CTRDLSymTable* symTable;
     CTRDLResolverFn resolver;
     void* resolverUserData;
+    u32* symValues;   // Resolved values, by symbol index.
+    u8* symStates;    // Resolution state, by symbol index.
+    size_t numRelocs; // Number of relocations applied.
+    size_t numUnique; // Number of distinct symbols resolved.
+#ifdef CTRDL_LOAD_STATS
+    size_t* numResolved; // Resolutions by scope, NULL after loading.
+#endif // CTRDL_LOAD_STATS
 } RelContext;
 
+struct CTRDLRelocPipeline {
+    RelContext ctx;
+    CTRDLElf* elf;
+    bool lazy;                // Jump slots are bound lazily.
+    CTRDLRelocRef* refs;      // Relocations, sorted by offset.
+    size_t numRefs;
+    size_t nextRef;           // Next relocation to apply.
+    size_t nextRelr;          // Next packed relocation to apply.
+    Elf32_Addr relrWhere;     // Address following the last packed address entry.
+    const Elf32_Rel* rel;
+    const Elf32_Rela* rela;
+    const void* jmpRel;
+};
+
+static inline const void* ctrdl_getRelocRefEntry(const CTRDLRelocPipeline* p, u32 ref) {
+    const size_t index = ref & CTRDL_RELOC_REF_INDEX_MASK;
+
+    switch (ref & ~CTRDL_RELOC_REF_INDEX_MASK) {
+        case CTRDL_RELOC_REF_REL:
+            return &p->rel[index];
+        case CTRDL_RELOC_REF_RELA:
+            return &p->rela[index];
+        default:
+            if (p->elf->jmpRelType == DT_REL)
+                return &((const Elf32_Rel*)p->jmpRel)[index];
+
+            return &((const Elf32_Rela*)p->jmpRel)[index];
+    }
+}
+
 typedef struct {
   uintptr_t offset;
   uintptr_t symbol;
@@ -24,16 +67,24 @@ typedef struct {
   bool isWeak;
 } RelEntry;
 
+static inline u32 ctrdl_countResolved(const RelContext* ctx, CTRDLSymScope scope, u32 addr) {
+#ifdef CTRDL_LOAD_STATS
+    if (ctx->numResolved)
+        ++ctx->numResolved[scope];
+#endif // CTRDL_LOAD_STATS
+    return addr;
+}
+
 // Relocations are processed in load order.
 static u32 ctrdl_resolveSymbol(const RelContext* ctx, Elf32_Word index, bool* isWeak) {
-    if (index == STN_UNDEF) {
+    if ((index == STN_UNDEF) || (index >= ctx->symTable->numSymEntries)) {
         *isWeak = false;
         return 0;
     }
 
     u32 symBase = 0;
-    const Elf32_Sym* symEntry = &ctx->elf->symEntries[index];
-    const char* name = &ctx->elf->stringTable[symEntry->st_name];
+    const Elf32_Sym* symEntry = &ctx->symTable->symEntries[index];
+    const char* name = &ctx->symTable->stringTable[symEntry->st_name];
     const bool weak = ELF32_ST_BIND(symEntry->st_info) == STB_WEAK;
     *isWeak = weak;
 
@@ -41,58 +92,56 @@ static u32 ctrdl_resolveSymbol(const RelContext* ctx, Elf32_Word index, bool* is
     if (ctx->resolver) {
         u32 addr = (u32)ctx->resolver(name, ctx->resolverUserData);
         if (addr)
-            return addr;
+            return ctrdl_countResolved(ctx, CTRDL_SCOPE_RESOLVER, addr);
     }
 
     // Look into program symbols.
     u32 addr = (u32)ctrdlProgramResolver(name);
     if (addr)
-        return addr;
-
-    // Look into global objects.
-    const Elf32_Sym* sym = NULL;
-    ctrdl_acquireHandleMtx();
-
-    for (size_t i = 0; i < ctrdl_unsafeNumHandles(); ++i) {
-        CTRDLHandle* h = ctrdl_unsafeGetHandleByIndex(i);
-        if (h->flags & RTLD_GLOBAL) {
-            sym = ctrdl_symNameLookupSingle(h, name);
-            if (sym) {
-                symBase = h->base;
-                break;
-            }
-        }
-    }
+        return ctrdl_countResolved(ctx, CTRDL_SCOPE_PROGRAM, addr);
 
-    ctrdl_releaseHandleMtx();
+    // Look into global objects, hashes are computed once for all of them.
+    CTRDLSymKey key;
+    ctrdl_makeELFSymKey(&key, name);
 
-    if (!sym) {
-        // Look into ourselves.
-        if (ctx->elf->numSymChains) {
-            const Elf32_Word hash = ctrdl_getELFSymNameHash(name);
-            size_t chainIndex = ctx->elf->symBuckets[hash % ctx->elf->numSymBuckets];
+    // Global objects are not held by this one, they may be unloaded once the read ends.
+    u32 phase;
+    ctrdl_beginRead(&phase);
+    const Elf32_Sym* sym = ctrdl_symNameLookupGlobal(&key, &symBase);
+    const u32 globalAddr = sym ? (symBase + sym->st_value) : 0;
+    ctrdl_endRead(phase);
 
-            while (chainIndex != STN_UNDEF) {
-                const Elf32_Sym* candidate = &ctx->elf->symEntries[chainIndex];
-                const bool skipSelf = candidate == symEntry && weak;
+    if (sym)
+        return ctrdl_countResolved(ctx, CTRDL_SCOPE_GLOBAL, globalAddr);
 
-                if (!skipSelf && !strcmp(&ctx->elf->stringTable[candidate->st_name], name)) {
-                    sym = candidate;
-                    symBase = ctx->handle->base;
-                    break;
-                }
+    // Look into ourselves.
+    sym = ctrdl_findELFSym(ctx->symTable, &key, weak ? symEntry : NULL);
+    if (sym)
+        return ctrdl_countResolved(ctx, CTRDL_SCOPE_SELF, ctx->handle->base + sym->st_value);
 
-                chainIndex = ctx->elf->symChains[chainIndex];
-            }
-        }
-    }
+    // Look into dependencies.
+    sym = ctrdl_symNameLookupLoadOrder(ctx->handle, &key, &symBase);
+    if (sym)
+        return ctrdl_countResolved(ctx, CTRDL_SCOPE_DEPS, symBase + sym->st_value);
+
+    return ctrdl_countResolved(ctx, CTRDL_SCOPE_NONE, 0);
+}
+
+// Each symbol is resolved once, no matter how many relocations reference it.
+static u32 ctrdl_resolveCachedSymbol(RelContext* ctx, Elf32_Word index, bool* isWeak) {
+    if ((index == STN_UNDEF) || (index >= ctx->symTable->numSymEntries))
+        return ctrdl_resolveSymbol(ctx, index, isWeak);
 
-    if (!sym) {
-        // Look into dependencies.
-        sym = ctrdl_symNameLookupLoadOrder(ctx->handle, name, &symBase);
+    *isWeak = ELF32_ST_BIND(ctx->symTable->symEntries[index].st_info) == STB_WEAK;
+
+    if (ctx->symStates[index] == SYM_UNRESOLVED) {
+        bool weak;
+        ctx->symValues[index] = ctrdl_resolveSymbol(ctx, index, &weak);
+        ctx->symStates[index] = SYM_RESOLVED;
+        ++ctx->numUnique;
     }
 
-    return sym ? (symBase + sym->st_value) : 0;
+    return ctx->symValues[index];
 }
 
 static bool ctrdl_handleSingleReloc(RelContext* ctx, RelEntry* entry) {
@@ -120,56 +169,430 @@ static bool ctrdl_handleSingleReloc(RelContext* ctx, RelEntry* entry) {
     return false;
 }
 
-static bool ctrdl_handleRel(RelContext* ctx) {
-    const Elf32_Rel* relArray = ctx->elf->relArray;
+// Linkers sort relative relocations first, DT_RELCOUNT/DT_RELACOUNT tell how many there are.
+static void ctrdl_handleRelativeRel(RelContext* ctx, const Elf32_Rel* relArray, size_t size) {
+    const u32 base = ctx->handle->base;
+
+    for (size_t i = 0; i < size; ++i)
+        *(u32*)(base + relArray[i].r_offset) += base;
+}
+
+static void ctrdl_handleRelativeRela(RelContext* ctx, const Elf32_Rela* relaArray, size_t size) {
+    const u32 base = ctx->handle->base;
 
-    if (relArray) {
-        const size_t size = ctx->elf->relArraySize;
-        for (size_t i = 0; i < size; ++i) {
-            RelEntry entry;
-            const Elf32_Rel* rel = &relArray[i];
+    for (size_t i = 0; i < size; ++i) {
+        u32* dst = (u32*)(base + relaArray[i].r_offset);
+        if (relaArray[i].r_addend) {
+            *dst = base + relaArray[i].r_addend;
+        } else {
+            *dst += base;
+        }
+    }
+}
 
-            entry.offset = ctx->handle->base + rel->r_offset;
-            entry.symbol = ctrdl_resolveSymbol(ctx, ELF32_R_SYM(rel->r_info), &entry.isWeak);
-            entry.addend = 0;
-            entry.type = ELF32_R_TYPE(rel->r_info);
+// Each even entry is an address, each odd entry is a bitmap of the 31 words that follow the last address.
+static void ctrdl_handleRelr(RelContext* ctx, Elf32_Addr addr, size_t size) {
+    const u32 base = ctx->handle->base;
+    const Elf32_Word* relrArray = (const Elf32_Word*)(base + addr);
+    u32* where = NULL;
+    size_t numRelocs = 0;
 
-            if (!ctrdl_handleSingleReloc(ctx, &entry))
-                return false;
+    for (size_t i = 0; i < size; ++i) {
+        Elf32_Word entry = relrArray[i];
+
+        if (!(entry & 1)) {
+            where = (u32*)(base + entry);
+            *where++ += base;
+            ++numRelocs;
+        } else if (where) {
+            u32* dst = where;
+            while ((entry >>= 1) != 0) {
+                if (entry & 1) {
+                    *dst += base;
+                    ++numRelocs;
+                }
+
+                ++dst;
+            }
+
+            where += 31;
         }
     }
 
+    ctx->numRelocs += numRelocs;
+}
+
+static bool ctrdl_applyRel(RelContext* ctx, const Elf32_Rel* rel) {
+    RelEntry entry;
+    entry.offset = ctx->handle->base + rel->r_offset;
+    entry.addend = 0;
+    entry.type = ELF32_R_TYPE(rel->r_info);
+
+    if (entry.type == R_ARM_RELATIVE) {
+        entry.symbol = 0;
+        entry.isWeak = false;
+    } else {
+        entry.symbol = ctrdl_resolveCachedSymbol(ctx, ELF32_R_SYM(rel->r_info), &entry.isWeak);
+    }
+
+    return ctrdl_handleSingleReloc(ctx, &entry);
+}
+
+static bool ctrdl_applyRela(RelContext* ctx, const Elf32_Rela* rela) {
+    RelEntry entry;
+    entry.offset = ctx->handle->base + rela->r_offset;
+    entry.addend = rela->r_addend;
+    entry.type = ELF32_R_TYPE(rela->r_info);
+
+    if (entry.type == R_ARM_RELATIVE) {
+        entry.symbol = 0;
+        entry.isWeak = false;
+    } else {
+        entry.symbol = ctrdl_resolveCachedSymbol(ctx, ELF32_R_SYM(rela->r_info), &entry.isWeak);
+    }
+
+    return ctrdl_handleSingleReloc(ctx, &entry);
+}
+
+static bool ctrdl_handleRel(RelContext* ctx, Elf32_Addr addr, size_t size, size_t numRelative) {
+    const Elf32_Rel* relArray = (const Elf32_Rel*)(ctx->handle->base + addr);
+    ctrdl_handleRelativeRel(ctx, relArray, numRelative);
+
+    for (size_t i = numRelative; i < size; ++i) {
+        if (!ctrdl_applyRel(ctx, &relArray[i]))
+            return false;
+    }
+
+    ctx->numRelocs += size;
     return true;
 }
 
-static bool ctrdl_handleRela(RelContext* ctx) {
-    const Elf32_Rela* relaArray = ctx->elf->relaArray;
+static bool ctrdl_handleRela(RelContext* ctx, Elf32_Addr addr, size_t size, size_t numRelative) {
+    const Elf32_Rela* relaArray = (const Elf32_Rela*)(ctx->handle->base + addr);
+    ctrdl_handleRelativeRela(ctx, relaArray, numRelative);
 
-    if (relaArray) {
-        const size_t size = ctx->elf->relaArraySize;
+    for (size_t i = numRelative; i < size; ++i) {
+        if (!ctrdl_applyRela(ctx, &relaArray[i]))
+            return false;
+    }
+
+    ctx->numRelocs += size;
+    return true;
+}
 
-        for (size_t i = 0; i < size; ++i) {
-            RelEntry entry;
-            const Elf32_Rela* rela = &relaArray[i];
+// Called from the trampoline on the first call through a jump slot.
+__attribute__((used)) u32 ctrdl_lazyBind(CTRDLHandle* handle, u32* slot) {
+    RelContext ctx;
+    ctx.handle = handle;
+    ctx.symTable = &handle->symTable;
+    ctx.resolver = handle->resolver;
+    ctx.resolverUserData = handle->resolverUserData;
+#ifdef CTRDL_LOAD_STATS
+    ctx.numResolved = NULL;
+#endif // CTRDL_LOAD_STATS
 
-            entry.offset = ctx->handle->base + rela->r_offset;
-            entry.symbol = ctrdl_resolveSymbol(ctx, ELF32_R_SYM(rela->r_info), &entry.isWeak);
-            entry.addend = rela->r_addend;
-            entry.type = ELF32_R_TYPE(rela->r_info);
+    // Slots usually follow relocation order, starting at GOT[3].
+    const Elf32_Addr offset = (u32)slot - handle->base;
+    const Elf32_Rel* rel = NULL;
+    const size_t index = slot - &handle->pltGot[3];
 
-            if (!ctrdl_handleSingleReloc(ctx, &entry))
-                return false;
+    if ((index < handle->numJmpRelEntries) && (handle->jmpRel[index].r_offset == offset)) {
+        rel = &handle->jmpRel[index];
+    } else {
+        for (size_t i = 0; i < handle->numJmpRelEntries; ++i) {
+            if (handle->jmpRel[i].r_offset == offset) {
+                rel = &handle->jmpRel[i];
+                break;
+            }
         }
     }
 
+    u32 value = 0;
+    if (rel && (ELF32_R_TYPE(rel->r_info) == R_ARM_JUMP_SLOT)) {
+        bool isWeak;
+        value = ctrdl_resolveSymbol(&ctx, ELF32_R_SYM(rel->r_info), &isWeak);
+    }
+
+    // There is nowhere to return to.
+    if (!value)
+        svcBreak(USERBREAK_PANIC);
+
+    // Concurrent binders store the same value.
+    __atomic_store_n(slot, value, __ATOMIC_RELEASE);
+    return value;
+}
+
+#ifdef __arm__
+// Entered from PLT0 with ip = &GOT[n], lr = &GOT[2], and the caller return address on the stack.
+__attribute__((naked, target("arm"))) static void ctrdl_lazyTrampoline(void) {
+    __asm__ volatile(
+        "push {r0-r4}\n"
+        "vpush {d0-d7}\n"
+        "ldr r0, [lr, #-4]\n"
+        "mov r1, ip\n"
+        "bl ctrdl_lazyBind\n"
+        "mov ip, r0\n"
+        "vpop {d0-d7}\n"
+        "pop {r0-r4, lr}\n"
+        "bx ip\n"
+    );
+}
+#else
+// Host builds never run object code.
+static void ctrdl_lazyTrampoline(void) { svcBreak(USERBREAK_PANIC); }
+#endif // __arm__
+
+static bool ctrdl_isLazyAllowed(const CTRDLHandle* handle, CTRDLElf* elf) {
+#ifdef __arm__
+    if (!(handle->flags & RTLD_LAZY) || (handle->flags & RTLD_NOW))
+        return false;
+
+    // Only REL jump slots are bound lazily, as emitted by ARM toolchains.
+    if (!elf->pltGotAddr || !elf->jmpRelArraySize || (elf->jmpRelType != DT_REL))
+        return false;
+
+    Elf32_Dyn entry;
+    if (ctrdl_getELFDynEntryWithTag(elf, DT_BIND_NOW, &entry))
+        return false;
+
+    if (ctrdl_getELFDynEntryWithTag(elf, DT_FLAGS, &entry) && (entry.d_un.d_val & DF_BIND_NOW))
+        return false;
+
     return true;
+#else
+    // Host builds bind jump slots eagerly.
+    (void)handle;
+    (void)elf;
+    return false;
+#endif // __arm__
+}
+
+static bool ctrdl_prepareLazyRel(RelContext* ctx, const CTRDLElf* elf) {
+    CTRDLHandle* handle = ctx->handle;
+    const Elf32_Rel* relArray = (const Elf32_Rel*)(handle->base + elf->jmpRelAddr);
+
+    for (size_t i = 0; i < elf->jmpRelArraySize; ++i) {
+        if (ELF32_R_TYPE(relArray[i].r_info) != R_ARM_JUMP_SLOT)
+            return false;
+
+        // Slots initially point to PLT0.
+        *(u32*)(handle->base + relArray[i].r_offset) += handle->base;
+    }
+
+    handle->pltGot = (u32*)(handle->base + elf->pltGotAddr);
+    handle->pltGot[1] = (u32)handle;
+    handle->pltGot[2] = (u32)ctrdl_lazyTrampoline;
+    handle->jmpRel = relArray;
+    handle->numJmpRelEntries = elf->jmpRelArraySize;
+    handle->resolver = ctx->resolver;
+    handle->resolverUserData = ctx->resolverUserData;
+    ctx->numRelocs += elf->jmpRelArraySize;
+    return true;
+}
+
+static bool ctrdl_initRelContext(RelContext* ctx, CTRDLHandle* handle, CTRDLElf* elf, CTRDLResolverFn resolver, void* resolverUserData) {
+    ctx->handle = handle;
+    ctx->symTable = &elf->symTable;
+    ctx->resolver = resolver;
+    ctx->resolverUserData = resolverUserData;
+    ctx->numRelocs = 0;
+    ctx->numUnique = 0;
+#ifdef CTRDL_LOAD_STATS
+    ctx->numResolved = handle->loadStats.numResolved;
+#endif // CTRDL_LOAD_STATS
+
+    // Values and states share a single allocation.
+    ctx->symValues = NULL;
+    ctx->symStates = NULL;
+
+    if (elf->symTable.numSymEntries) {
+        ctx->symValues = malloc(elf->symTable.numSymEntries * (sizeof(u32) + sizeof(u8)));
+        if (!ctx->symValues) {
+            ctrdl_setLastError(Err_NoMemory);
+            return false;
+        }
+
+        ++elf->numAllocs;
+        ctx->symStates = (u8*)(ctx->symValues + elf->symTable.numSymEntries);
+        memset(ctx->symStates, SYM_UNRESOLVED, elf->symTable.numSymEntries);
+    }
+
+    return true;
+}
+
+static void ctrdl_freeRelContext(RelContext* ctx) {
+    free(ctx->symValues);
+    ctx->handle->numRelocs = ctx->numRelocs;
+    ctx->handle->numResolvedSyms = ctx->numUnique;
 }
 
 bool ctrdl_handleRelocs(CTRDLHandle* handle, CTRDLElf* elf, CTRDLResolverFn resolver, void* resolverUserData) {
     RelContext ctx;
-    ctx.handle = handle;
-    ctx.elf = elf;
-    ctx.resolver = resolver;
-    ctx.resolverUserData = resolverUserData;
-    return ctrdl_handleRel(&ctx) && ctrdl_handleRela(&ctx);
-}
\ No newline at end of file
+    if (!ctrdl_initRelContext(&ctx, handle, elf, resolver, resolverUserData))
+        return false;
+
+    // Relocation tables are accessed through the mapped image.
+    ctrdl_handleRelr(&ctx, elf->relrAddr, elf->relrArraySize);
+
+    bool success = ctrdl_handleRel(&ctx, elf->relAddr, elf->relArraySize, elf->relCount) &&
+        ctrdl_handleRela(&ctx, elf->relaAddr, elf->relaArraySize, elf->relaCount);
+
+    // Data relocations are always bound eagerly.
+    if (success) {
+        if (ctrdl_isLazyAllowed(handle, elf)) {
+            success = ctrdl_prepareLazyRel(&ctx, elf);
+        } else if (elf->jmpRelType == DT_REL) {
+            success = ctrdl_handleRel(&ctx, elf->jmpRelAddr, elf->jmpRelArraySize, 0);
+        } else {
+            success = ctrdl_handleRela(&ctx, elf->jmpRelAddr, elf->jmpRelArraySize, 0);
+        }
+    }
+
+    ctrdl_freeRelContext(&ctx);
+    return success;
+}
+
+static int ctrdl_compareRelocRefs(const void* a, const void* b) {
+    const Elf32_Addr lhs = ((const CTRDLRelocRef*)a)->offset;
+    const Elf32_Addr rhs = ((const CTRDLRelocRef*)b)->offset;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static inline void ctrdl_addRelocRefs(CTRDLRelocRef* refs, size_t* numRefs, const void* table, size_t size, size_t entrySize, u32 tag) {
+    // r_offset is the first field of both entry types.
+    for (size_t i = 0; i < size; ++i) {
+        CTRDLRelocRef* ref = &refs[(*numRefs)++];
+        ref->offset = *(const Elf32_Addr*)((const u8*)table + i * entrySize);
+        ref->ref = tag | i;
+    }
+}
+
+CTRDLRelocPipeline* ctrdl_beginRelocs(CTRDLHandle* handle, CTRDLElf* elf, CTRDLResolverFn resolver, void* resolverUserData) {
+    const bool lazy = ctrdl_isLazyAllowed(handle, elf);
+    const size_t numJmpRel = lazy ? 0 : elf->jmpRelArraySize;
+    const size_t numRefs = elf->relArraySize + elf->relaArraySize + numJmpRel;
+
+    if (numRefs > CTRDL_RELOC_REF_INDEX_MASK) {
+        ctrdl_setLastError(Err_InvalidObject);
+        return NULL;
+    }
+
+    CTRDLRelocPipeline* p = malloc(sizeof(CTRDLRelocPipeline) + numRefs * sizeof(CTRDLRelocRef));
+    if (!p) {
+        ctrdl_setLastError(Err_NoMemory);
+        return NULL;
+    }
+
+    ++elf->numAllocs;
+    if (!ctrdl_initRelContext(&p->ctx, handle, elf, resolver, resolverUserData)) {
+        free(p);
+        return NULL;
+    }
+
+    const u32 base = handle->base;
+    p->elf = elf;
+    p->lazy = lazy;
+    p->refs = (CTRDLRelocRef*)(p + 1);
+    p->numRefs = 0;
+    p->nextRef = 0;
+    p->nextRelr = 0;
+    p->relrWhere = 0;
+    p->rel = (const Elf32_Rel*)(base + elf->relAddr);
+    p->rela = (const Elf32_Rela*)(base + elf->relaAddr);
+    p->jmpRel = (const void*)(base + elf->jmpRelAddr);
+
+    ctrdl_addRelocRefs(p->refs, &p->numRefs, p->rel, elf->relArraySize, sizeof(Elf32_Rel), CTRDL_RELOC_REF_REL);
+    ctrdl_addRelocRefs(p->refs, &p->numRefs, p->rela, elf->relaArraySize, sizeof(Elf32_Rela), CTRDL_RELOC_REF_RELA);
+    ctrdl_addRelocRefs(p->refs, &p->numRefs, p->jmpRel, numJmpRel,
+        (elf->jmpRelType == DT_REL) ? sizeof(Elf32_Rel) : sizeof(Elf32_Rela), CTRDL_RELOC_REF_JMPREL);
+
+    // Symbols only need the tables, they are resolved while the rest of the image is read.
+    for (size_t i = 0; i < p->numRefs; ++i) {
+        const Elf32_Word info = ((const Elf32_Rel*)ctrdl_getRelocRefEntry(p, p->refs[i].ref))->r_info;
+        if (ELF32_R_TYPE(info) != R_ARM_RELATIVE) {
+            bool isWeak;
+            ctrdl_resolveCachedSymbol(&p->ctx, ELF32_R_SYM(info), &isWeak);
+        }
+    }
+
+    // Each chunk is then finished in one go.
+    qsort(p->refs, p->numRefs, sizeof(CTRDLRelocRef), ctrdl_compareRelocRefs);
+    return p;
+}
+
+static bool ctrdl_applyRelocRef(CTRDLRelocPipeline* p, u32 ref) {
+    const void* entry = ctrdl_getRelocRefEntry(p, ref);
+    const u32 tag = ref & ~CTRDL_RELOC_REF_INDEX_MASK;
+
+    if ((tag == CTRDL_RELOC_REF_RELA) || ((tag == CTRDL_RELOC_REF_JMPREL) && (p->elf->jmpRelType == DT_RELA)))
+        return ctrdl_applyRela(&p->ctx, (const Elf32_Rela*)entry);
+
+    return ctrdl_applyRel(&p->ctx, (const Elf32_Rel*)entry);
+}
+
+// Packed entries are consumed as long as every word they touch is below the end.
+static void ctrdl_applyRelrBelow(CTRDLRelocPipeline* p, Elf32_Addr end) {
+    const u32 base = p->ctx.handle->base;
+    const Elf32_Word* relrArray = (const Elf32_Word*)(base + p->elf->relrAddr);
+
+    while (p->nextRelr < p->elf->relrArraySize) {
+        Elf32_Word entry = relrArray[p->nextRelr];
+
+        if (!(entry & 1)) {
+            if ((entry + sizeof(u32)) > end)
+                return;
+
+            *(u32*)(base + entry) += base;
+            p->relrWhere = entry + sizeof(u32);
+            ++p->ctx.numRelocs;
+        } else if (p->relrWhere) {
+            const Elf32_Addr last = p->relrWhere + (30 - __builtin_clz(entry)) * sizeof(u32);
+            if ((last + sizeof(u32)) > end)
+                return;
+
+            u32* dst = (u32*)(base + p->relrWhere);
+            while ((entry >>= 1) != 0) {
+                if (entry & 1) {
+                    *dst += base;
+                    ++p->ctx.numRelocs;
+                }
+
+                ++dst;
+            }
+
+            p->relrWhere += 31 * sizeof(u32);
+        }
+
+        ++p->nextRelr;
+    }
+}
+
+bool ctrdl_applyRelocsBelow(CTRDLRelocPipeline* p, Elf32_Addr end) {
+    while ((p->nextRef < p->numRefs) && ((p->refs[p->nextRef].offset + sizeof(u32)) <= end)) {
+        if (!ctrdl_applyRelocRef(p, p->refs[p->nextRef].ref))
+            return false;
+
+        ++p->ctx.numRelocs;
+        ++p->nextRef;
+    }
+
+    ctrdl_applyRelrBelow(p, end);
+    return true;
+}
+
+bool ctrdl_endRelocs(CTRDLRelocPipeline* p) {
+    // Everything must have been read by now.
+    bool success = ctrdl_applyRelocsBelow(p, UINT32_MAX) && (p->nextRef == p->numRefs) && (p->nextRelr == p->elf->relrArraySize);
+
+    if (success && p->lazy)
+        success = ctrdl_prepareLazyRel(&p->ctx, p->elf);
+
+    ctrdl_freeRelContext(&p->ctx);
+    free(p);
+    return success;
+}
+
+void ctrdl_abortRelocs(CTRDLRelocPipeline* p) {
+    ctrdl_freeRelContext(&p->ctx);
+    free(p);
+}
@@ -10,6 +10,24 @@
 #include "ELFUtil.h"
 #include "Handle.h"
 
+#define CTRDL_RELOC_REF_REL 0x00000000
+#define CTRDL_RELOC_REF_RELA 0x40000000
+#define CTRDL_RELOC_REF_JMPREL 0x80000000
+#define CTRDL_RELOC_REF_INDEX_MASK 0x3FFFFFFF
+
+typedef struct {
+    Elf32_Addr offset; // Relocated address.
+    u32 ref;           // Table tag and entry index.
+} CTRDLRelocRef;
+
+typedef struct CTRDLRelocPipeline CTRDLRelocPipeline;
+
 bool ctrdl_handleRelocs(CTRDLHandle* handle, CTRDLElf* elf, CTRDLResolverFn resolver, void* resolverUserData);
 
+// Relocations are applied in address order while the image is being read; tables must be available already.
+CTRDLRelocPipeline* ctrdl_beginRelocs(CTRDLHandle* handle, CTRDLElf* elf, CTRDLResolverFn resolver, void* resolverUserData);
+bool ctrdl_applyRelocsBelow(CTRDLRelocPipeline* p, Elf32_Addr end);
+bool ctrdl_endRelocs(CTRDLRelocPipeline* p);
+void ctrdl_abortRelocs(CTRDLRelocPipeline* p);
+
 #endif /* _CTRDL_RELOCS_H */
\ No newline at end of file
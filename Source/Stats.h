@@ -0,0 +1,23 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _CTRDL_STATS_H
+#define _CTRDL_STATS_H
+
+#include <dlfcn.h>
+
+// Instrumentation compiles to nothing unless CTRDL_LOAD_STATS is defined, arguments are not evaluated then.
+#ifdef CTRDL_LOAD_STATS
+#define CTRDL_STATS_BEGIN(tick) const u64 tick = svcGetSystemTick()
+#define CTRDL_STATS_END(stats, phase, tick) ((stats)->ticks[(phase)] += svcGetSystemTick() - (tick))
+#define CTRDL_STATS_ADD(stats, field, n) ((stats)->field += (n))
+#else
+#define CTRDL_STATS_BEGIN(tick) ((void)0)
+#define CTRDL_STATS_END(stats, phase, tick) ((void)0)
+#define CTRDL_STATS_ADD(stats, field, n) ((void)0)
+#endif // CTRDL_LOAD_STATS
+
+#endif /* _CTRDL_STATS_H */
@@ -5,6 +5,7 @@
  */
 
 #include "Stream.h"
+#include "Stats.h"
 
 #include <string.h>
 
@@ -53,15 +54,70 @@ static bool ctrdl_memReadImpl(void* s, void* out, size_t size) {
 }
 
 void ctrdl_makeFileStream(CTRDLStream* stream, FILE* f) {
+    const long pos = ftell(f);
+
     stream->handle = (void*)f;
     stream->seek = ctrdl_fileSeekImpl;
     stream->read = ctrdl_fileReadImpl;
+    stream->size = 0;
+    stream->offset = 0;
+    stream->pos = pos >= 0 ? (size_t)pos : CTRDL_STREAM_POS_UNKNOWN;
+    stream->numSeeks = 0;
+    stream->numReads = 0;
+#ifdef CTRDL_LOAD_STATS
+    stream->bytesRead = 0;
+#endif // CTRDL_LOAD_STATS
 }
 
 void ctrdl_makeMemStream(CTRDLStream* stream, const void* buffer, size_t size) {
     stream->handle = (void*)buffer;
     stream->seek = ctrdl_memSeekImpl;
     stream->read = ctrdl_memReadImpl;
-    stream->size = 0;
+    stream->size = size;
     stream->offset = 0;
-}
\ No newline at end of file
+    stream->pos = 0;
+    stream->numSeeks = 0;
+    stream->numReads = 0;
+#ifdef CTRDL_LOAD_STATS
+    stream->bytesRead = 0;
+#endif // CTRDL_LOAD_STATS
+}
+
+bool ctrdl_streamSeek(CTRDLStream* stream, size_t offset) {
+    if (stream->pos == offset)
+        return true;
+
+    ++stream->numSeeks;
+    if (!stream->seek(stream, offset)) {
+        stream->pos = CTRDL_STREAM_POS_UNKNOWN;
+        return false;
+    }
+
+    stream->pos = offset;
+    return true;
+}
+
+bool ctrdl_streamRead(CTRDLStream* stream, void* out, size_t size) {
+    ++stream->numReads;
+    if (!stream->read(stream, out, size)) {
+        stream->pos = CTRDL_STREAM_POS_UNKNOWN;
+        return false;
+    }
+
+    if (stream->pos != CTRDL_STREAM_POS_UNKNOWN)
+        stream->pos += size;
+
+    CTRDL_STATS_ADD(stream, bytesRead, size);
+
+    return true;
+}
+
+const void* ctrdl_streamMap(CTRDLStream* stream, size_t offset, size_t size) {
+    if (stream->seek != ctrdl_memSeekImpl)
+        return NULL;
+
+    if ((offset > stream->size) || (size > (stream->size - offset)))
+        return NULL;
+
+    return (const void*)((const u8*)(stream->handle) + offset);
+}
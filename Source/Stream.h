@@ -10,6 +10,8 @@
 #include <dlfcn.h>
 #include <stdio.h>
 
+#define CTRDL_STREAM_POS_UNKNOWN ((size_t)-1)
+
 typedef bool(*CTRDLSeekFn)(void* stream, size_t offset);
 typedef bool(*CTRDLReadFn)(void* stream, void* out, size_t size);
 
@@ -19,9 +21,22 @@ typedef struct {
     CTRDLReadFn read; // Read function.
     size_t size;      // Stream size (memory only).
     size_t offset;    // Stream offset (memory only).
+    size_t pos;       // Tracked position.
+    size_t numSeeks;  // Number of seeks issued.
+    size_t numReads;  // Number of reads issued.
+#ifdef CTRDL_LOAD_STATS
+    size_t bytesRead; // Number of bytes read.
+#endif // CTRDL_LOAD_STATS
 } CTRDLStream;
 
 void ctrdl_makeFileStream(CTRDLStream* stream, FILE* f);
 void ctrdl_makeMemStream(CTRDLStream* stream, const void* buffer, size_t size);
 
-#endif /* _CTRDL_STREAM_H */
\ No newline at end of file
+// Seeks are skipped when the stream is already at the requested offset.
+bool ctrdl_streamSeek(CTRDLStream* stream, size_t offset);
+bool ctrdl_streamRead(CTRDLStream* stream, void* out, size_t size);
+
+// Returns a pointer to the data in place for memory streams, NULL otherwise.
+const void* ctrdl_streamMap(CTRDLStream* stream, size_t offset, size_t size);
+
+#endif /* _CTRDL_STREAM_H */
@@ -6,138 +6,401 @@
 
 #include "Symbol.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#define CTRDL_GLOBAL_CACHE_SIZE 256 // Power of two.
+
+typedef struct {
+    CTRDLHandle* handle; // Visited object.
+    size_t nextDep;      // Next dependency to visit.
+} ScopeFrame;
+
 typedef struct {
-    CTRDLHandle* deps[CTRDL_MAX_HANDLES];
-    size_t size;
-    size_t index;
-} DepQueue;
+    u32 seq;              // Odd while the entry is being filled.
+    u32 generation;       // Snapshot generation the entry was filled in.
+    u32 hash;             // Symbol name hash.
+    CTRDLHandle* handle;  // Owner.
+    const Elf32_Sym* sym; // Symbol.
+} GlobalCacheEntry;
+
+// Entries are only valid for the snapshot they were filled from, 0 is never valid.
+static GlobalCacheEntry g_GlobalCache[CTRDL_GLOBAL_CACHE_SIZE];
+
+// Scope walks stamp the objects they visit, they are serialized since stamps are stored in handles.
+static LightLock g_ScopeLock;
+static u32 g_ScopeStamp = 0;
 
-static inline void ctrdl_depQueueInit(DepQueue* q) {
-    q->size = 0;
-    q->index = 0;
+const Elf32_Sym* ctrdl_symNameLookupSingle(CTRDLHandle* handle, CTRDLSymKey* key) {
+    if (handle)
+        return ctrdl_findELFSym(&handle->symTable, key, NULL);
+
+    return NULL;
 }
 
-static inline bool ctrdl_depQueueIsEmpty(DepQueue* q) { return q->size == 0; }
-static inline bool ctrdl_depQueueIsFull(DepQueue* q) { return q->size >= CTRDL_MAX_HANDLES; }
+static const Elf32_Sym* ctrdl_probeGlobalCache(GlobalCacheEntry* entry, u32 generation, const CTRDLSymKey* key, u32* modBase) {
+    const u32 seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1)
+        return NULL;
 
-static void ctrdl_depQueuePush(DepQueue* q, CTRDLHandle* handle) {
-    if (handle && !ctrdl_depQueueIsFull(q)) {
-        for (size_t i = 0; i < q->size; ++i) {
-            if (q->deps[i] == handle)
-                return;
-        }
+    const u32 entryGeneration = __atomic_load_n(&entry->generation, __ATOMIC_RELAXED);
+    const u32 hash = __atomic_load_n(&entry->hash, __ATOMIC_RELAXED);
+    CTRDLHandle* handle = __atomic_load_n(&entry->handle, __ATOMIC_RELAXED);
+    const Elf32_Sym* sym = __atomic_load_n(&entry->sym, __ATOMIC_RELAXED);
+
+    // Read-only update, ordered after the loads above; fillers which changed them meanwhile changed seq first.
+    if (__atomic_fetch_add(&entry->seq, 0, __ATOMIC_RELEASE) != seq)
+        return NULL;
+
+    // Entries of the current generation only reference objects in the snapshot.
+    if ((entryGeneration != generation) || (hash != key->gnuHash) || !ctrdl_matchELFSymName(&handle->symTable, sym, key))
+        return NULL;
 
-        q->deps[q->size % CTRDL_MAX_HANDLES] = handle;
-        ++q->size;
+    *modBase = handle->base;
+    return sym;
+}
+
+static void ctrdl_fillGlobalCache(GlobalCacheEntry* entry, u32 generation, const CTRDLSymKey* key, CTRDLHandle* handle, const Elf32_Sym* sym) {
+    // Entries being filled by another reader are left alone.
+    u32 seq = __atomic_load_n(&entry->seq, __ATOMIC_RELAXED);
+    if ((seq & 1) || !__atomic_compare_exchange_n(&entry->seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+
+    __atomic_store_n(&entry->generation, generation, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->hash, key->gnuHash, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->handle, handle, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->sym, sym, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+const Elf32_Sym* ctrdl_symNameLookupGlobal(CTRDLSymKey* key, u32* modBase) {
+    u32 phase;
+    const CTRDLHandleSnapshot* snapshot = ctrdl_beginRead(&phase);
+
+    GlobalCacheEntry* entry = &g_GlobalCache[key->gnuHash & (CTRDL_GLOBAL_CACHE_SIZE - 1)];
+    const Elf32_Sym* found = ctrdl_probeGlobalCache(entry, snapshot->generation, key, modBase);
+
+    // Global objects are searched in load order.
+    for (size_t i = 0; !found && (i < snapshot->numGlobals); ++i) {
+        CTRDLHandle* h = snapshot->globals[i];
+        found = ctrdl_findELFSym(&h->symTable, key, NULL);
+        if (found) {
+            *modBase = h->base;
+            ctrdl_fillGlobalCache(entry, snapshot->generation, key, h, found);
+        }
     }
+
+    ctrdl_endRead(phase);
+    return found;
 }
 
-static CTRDLHandle* ctrdl_depQueuePop(DepQueue* q) {
-    if (!ctrdl_depQueueIsEmpty(q)) {
-        CTRDLHandle* h = q->deps[q->index];
-        q->index = (q->index + 1) % CTRDL_MAX_HANDLES;
-        --q->size;
-        return h;
+static void ctrdl_scopeLockLazyInit(void) {
+    static u8 initialized = 0;
+
+    if (!__ldrexb(&initialized)) {
+        LightLock_Init(&g_ScopeLock);
+
+        while (__strexb(&initialized, 1))
+            __ldrexb(&initialized);
+    } else {
+        __clrex();
     }
+}
 
-    return NULL;
+// Fresh handles have a 0 stamp, which is never used.
+static u32 ctrdl_nextScopeStamp(void) {
+    if (!++g_ScopeStamp)
+        ++g_ScopeStamp;
+
+    return g_ScopeStamp;
 }
 
-const Elf32_Sym* ctrdl_symNameLookupSingle(CTRDLHandle* handle, const char* name) {
-    const Elf32_Sym* found = NULL;
+// Returns false if the walk already visited the object.
+static inline bool ctrdl_markVisited(CTRDLHandle* handle, u32 stamp) {
+    if (handle->scopeStamp == stamp)
+        return false;
 
-    if (handle) {
-        ctrdl_lockHandle(handle);
+    handle->scopeStamp = stamp;
+    return true;
+}
 
-        if (handle->numSymChains) {
-            const Elf32_Word hash = ctrdl_getELFSymNameHash(name);
-            size_t chainIndex = handle->symBuckets[hash % handle->numSymBuckets];
+// Breadth first, the scope doubles as the queue.
+static CTRDLHandle** ctrdl_collectDepOrder(CTRDLHandle* handle, size_t* size) {
+    size_t capacity = handle->numDeps + 1;
+    CTRDLHandle** scope = malloc(capacity * sizeof(CTRDLHandle*));
+    if (!scope)
+        return NULL;
+
+    const u32 stamp = ctrdl_nextScopeStamp();
+    size_t count = 0;
+    scope[count++] = handle;
+    ctrdl_markVisited(handle, stamp);
+
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < scope[i]->numDeps; ++j) {
+            CTRDLHandle* dep = scope[i]->deps[j];
+            if (!dep || !ctrdl_markVisited(dep, stamp))
+                continue;
 
-            while (chainIndex != STN_UNDEF) {
-                const Elf32_Sym* sym = &handle->symEntries[chainIndex];
-                if (!strcmp(&handle->stringTable[sym->st_name], name)) {
-                    found = sym;
-                    break;
+            if (count == capacity) {
+                CTRDLHandle** grown = realloc(scope, 2 * capacity * sizeof(CTRDLHandle*));
+                if (!grown) {
+                    free(scope);
+                    return NULL;
                 }
 
-                chainIndex = handle->symChains[chainIndex];
+                scope = grown;
+                capacity *= 2;
             }
+
+            scope[count++] = dep;
+        }
+    }
+
+    *size = count;
+    return scope;
+}
+
+// Depth first, every object is visited once even within cycles; dependencies are initialized before dependents.
+static void ctrdl_collectLoadOrder(CTRDLHandle* handle, CTRDLHandle** scope, CTRDLHandle** initOrder, ScopeFrame* stack) {
+    const u32 stamp = ctrdl_nextScopeStamp();
+    size_t count = 0;
+    size_t numInit = 0;
+    size_t stackSize = 0;
+
+    scope[count++] = handle;
+    ctrdl_markVisited(handle, stamp);
+    stack[stackSize].handle = handle;
+    stack[stackSize].nextDep = 0;
+    ++stackSize;
+
+    while (stackSize) {
+        ScopeFrame* frame = &stack[stackSize - 1];
+        if (frame->nextDep == frame->handle->numDeps) {
+            initOrder[numInit++] = frame->handle;
+            --stackSize;
+            continue;
+        }
+
+        CTRDLHandle* dep = frame->handle->deps[frame->nextDep++];
+        if (dep && ctrdl_markVisited(dep, stamp)) {
+            scope[count++] = dep;
+            stack[stackSize].handle = dep;
+            stack[stackSize].nextDep = 0;
+            ++stackSize;
         }
+    }
+}
 
-        ctrdl_unlockHandle(handle);
+static CTRDLScopes* ctrdl_buildScopes(CTRDLHandle* handle) {
+    // Every scope holds the same objects, in different order.
+    size_t size = 0;
+    CTRDLHandle** depOrder = ctrdl_collectDepOrder(handle, &size);
+    if (!depOrder)
+        return NULL;
+
+    CTRDLScopes* scopes = malloc(sizeof(CTRDLScopes) + 3 * size * sizeof(CTRDLHandle*));
+    ScopeFrame* stack = malloc(size * sizeof(ScopeFrame));
+    if (!scopes || !stack) {
+        free(stack);
+        free(scopes);
+        free(depOrder);
+        return NULL;
     }
 
-    return found;
+    scopes->size = size;
+    ctrdl_collectLoadOrder(handle, scopes->handles, &scopes->handles[2 * size], stack);
+    memcpy(&scopes->handles[size], depOrder, size * sizeof(CTRDLHandle*));
+
+    free(stack);
+    free(depOrder);
+    return scopes;
 }
 
-const Elf32_Sym* ctrdl_symNameLookupLoadOrder(CTRDLHandle* handle, const char* name, u32* modBase) {
-    const Elf32_Sym* found = NULL;
+CTRDLScopes* ctrdl_makeScopes(CTRDLHandle* handle) {
+    ctrdl_scopeLockLazyInit();
+    LightLock_Lock(&g_ScopeLock);
+    CTRDLScopes* scopes = ctrdl_buildScopes(handle);
+    LightLock_Unlock(&g_ScopeLock);
+    return scopes;
+}
 
-    if (handle) {
-        ctrdl_lockHandle(handle);
+static const Elf32_Sym* ctrdl_symNameLookupScope(CTRDLHandle* const* scope, size_t size, CTRDLSymKey* key, u32* modBase) {
+    for (size_t i = 0; i < size; ++i) {
+        CTRDLHandle* h = scope[i];
+        const Elf32_Sym* found = ctrdl_findELFSym(&h->symTable, key, NULL);
+        if (found) {
+            if (modBase)
+                *modBase = h->base;
 
-        found = ctrdl_symNameLookupSingle(handle, name);
-        if (!found) {
-            for (size_t i = 0; i < CTRDL_MAX_DEPS; ++i) {
-                found = ctrdl_symNameLookupLoadOrder(handle->deps[i], name, modBase);
-                if (found)
-                    break;
-            }
-        } else if (modBase) {
-            *modBase = handle->base;
+            return found;
         }
+    }
+
+    return NULL;
+}
 
-        ctrdl_unlockHandle(handle);
+// Scopes may be rebuilt meanwhile, replaced ones are freed once readers are done.
+static const Elf32_Sym* ctrdl_symNameLookupHandleScope(CTRDLHandle* handle, bool depOrder, CTRDLSymKey* key, u32* modBase) {
+    if (!handle)
+        return NULL;
+
+    u32 phase;
+    ctrdl_beginRead(&phase);
+
+    // Objects still being loaded only search themselves.
+    const Elf32_Sym* found = NULL;
+    const CTRDLScopes* scopes = __atomic_load_n(&handle->scopes, __ATOMIC_ACQUIRE);
+    if (scopes) {
+        found = ctrdl_symNameLookupScope(depOrder ? &scopes->handles[scopes->size] : scopes->handles, scopes->size, key, modBase);
+    } else {
+        found = ctrdl_symNameLookupScope(&handle, 1, key, modBase);
     }
 
+    ctrdl_endRead(phase);
     return found;
 }
 
-const Elf32_Sym* ctrdl_symNameLookupDepOrder(CTRDLHandle* handle, const char* name) {
-    DepQueue q;
-    const Elf32_Sym* found = NULL;
+const Elf32_Sym* ctrdl_symNameLookupLoadOrder(CTRDLHandle* handle, CTRDLSymKey* key, u32* modBase) {
+    return ctrdl_symNameLookupHandleScope(handle, false, key, modBase);
+}
 
-    if (handle) {
-        ctrdl_lockHandle(handle);
+const Elf32_Sym* ctrdl_symNameLookupDepOrder(CTRDLHandle* handle, CTRDLSymKey* key, u32* modBase) {
+    return ctrdl_symNameLookupHandleScope(handle, true, key, modBase);
+}
+
+// Entries which were already resolved are skipped.
+static size_t ctrdl_symNameLookupScopeBatch(CTRDLHandle* const* scope, size_t scopeSize, CTRDLSymBatchEntry* entries, size_t count, size_t missing, u32 generation) {
+    for (size_t i = 0; missing && (i < scopeSize); ++i) {
+        CTRDLHandle* h = scope[i];
 
-        ctrdl_depQueueInit(&q);
-        ctrdl_depQueuePush(&q, handle);
+        for (size_t j = 0; j < count; ++j) {
+            CTRDLSymBatchEntry* entry = &entries[j];
+            if (entry->sym)
+                continue;
 
-        while (!ctrdl_depQueueIsEmpty(&q)) {
-            CTRDLHandle* h = ctrdl_depQueuePop(&q);
-            found = ctrdl_symNameLookupSingle(h, name);
-            if (found)
-                break;
+            entry->sym = ctrdl_findELFSym(&h->symTable, &entry->key, NULL);
+            if (entry->sym) {
+                entry->modBase = h->base;
+                if (generation)
+                    ctrdl_fillGlobalCache(&g_GlobalCache[entry->key.gnuHash & (CTRDL_GLOBAL_CACHE_SIZE - 1)], generation, &entry->key, h, entry->sym);
 
-            for (size_t i = 0; i < CTRDL_MAX_DEPS; ++i)
-                ctrdl_depQueuePush(&q, h->deps[i]);
+                --missing;
+            }
         }
+    }
 
-        ctrdl_unlockHandle(handle);
+    return missing;
+}
+
+size_t ctrdl_symNameLookupGlobalBatch(CTRDLSymBatchEntry* entries, size_t count) {
+    u32 phase;
+    const CTRDLHandleSnapshot* snapshot = ctrdl_beginRead(&phase);
+    size_t missing = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        CTRDLSymBatchEntry* entry = &entries[i];
+        if (!entry->sym) {
+            GlobalCacheEntry* cacheEntry = &g_GlobalCache[entry->key.gnuHash & (CTRDL_GLOBAL_CACHE_SIZE - 1)];
+            entry->sym = ctrdl_probeGlobalCache(cacheEntry, snapshot->generation, &entry->key, &entry->modBase);
+            if (!entry->sym)
+                ++missing;
+        }
     }
 
-    return found;
+    missing = ctrdl_symNameLookupScopeBatch(snapshot->globals, snapshot->numGlobals, entries, count, missing, snapshot->generation);
+    ctrdl_endRead(phase);
+    return missing;
 }
 
-const Elf32_Sym* ctrdl_symValueLookupSingle(CTRDLHandle* handle, Elf32_Word value) {
-    const Elf32_Sym* found = NULL;
+size_t ctrdl_symNameLookupDepOrderBatch(CTRDLHandle* handle, CTRDLSymBatchEntry* entries, size_t count) {
+    size_t missing = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!entries[i].sym)
+            ++missing;
+    }
+
+    if (!handle)
+        return missing;
+
+    u32 phase;
+    ctrdl_beginRead(&phase);
+
+    const CTRDLScopes* scopes = __atomic_load_n(&handle->scopes, __ATOMIC_ACQUIRE);
+    if (scopes) {
+        missing = ctrdl_symNameLookupScopeBatch(&scopes->handles[scopes->size], scopes->size, entries, count, missing, 0);
+    } else {
+        missing = ctrdl_symNameLookupScopeBatch(&handle, 1, entries, count, missing, 0);
+    }
+
+    ctrdl_endRead(phase);
+    return missing;
+}
 
-    if (handle) {
-        ctrdl_lockHandle(handle);
+static int ctrdl_compareSymAddrs(const void* a, const void* b) {
+    const CTRDLSymAddr* lhs = (const CTRDLSymAddr*)a;
+    const CTRDLSymAddr* rhs = (const CTRDLSymAddr*)b;
+    if (lhs->addr != rhs->addr)
+        return (lhs->addr > rhs->addr) - (lhs->addr < rhs->addr);
+
+    return (lhs->index > rhs->index) - (lhs->index < rhs->index);
+}
 
-        for (size_t i = 0; i < handle->numSymChains; ++i) {
-            if (i == STN_UNDEF)
+static const CTRDLSymAddr* ctrdl_getSymAddrs(CTRDLHandle* handle, size_t* size) {
+    CTRDLSymAddr* symAddrs = __atomic_load_n(&handle->symAddrs, __ATOMIC_ACQUIRE);
+
+    // Built by the first lookup, concurrent ones may race to publish theirs.
+    if (!symAddrs) {
+        const CTRDLSymTable* table = &handle->symTable;
+        size_t count = 0;
+        CTRDLSymAddr* entries = malloc((table->numSymEntries ? table->numSymEntries : 1) * sizeof(CTRDLSymAddr));
+        if (!entries)
+            return NULL;
+
+        for (size_t i = STN_UNDEF + 1; i < table->numSymEntries; ++i) {
+            const Elf32_Sym* sym = &table->symEntries[i];
+            const u8 type = ELF32_ST_TYPE(sym->st_info);
+            if ((sym->st_shndx == SHN_UNDEF) || ((type != STT_FUNC) && (type != STT_OBJECT)))
                 continue;
 
-            const Elf32_Sym* sym = &handle->symEntries[i];
-            if ((sym->st_value >= value) && (value < (sym->st_value + sym->st_size))) {
-                found = sym;
-                break;
-            }
+            // Thumb functions have the low bit set.
+            entries[count].addr = (type == STT_FUNC) ? (sym->st_value & ~1) : sym->st_value;
+            entries[count].index = i;
+            ++count;
         }
 
-        ctrdl_unlockHandle(handle);
+        qsort(entries, count, sizeof(CTRDLSymAddr), ctrdl_compareSymAddrs);
+
+        // Every lookup computes the same size.
+        __atomic_store_n(&handle->numSymAddrs, count, __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&handle->symAddrs, &symAddrs, entries, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            symAddrs = entries;
+        } else {
+            free(entries);
+        }
     }
 
-    return found;
+    *size = __atomic_load_n(&handle->numSymAddrs, __ATOMIC_RELAXED);
+    return symAddrs;
+}
+
+const Elf32_Sym* ctrdl_symValueLookupSingle(CTRDLHandle* handle, Elf32_Word value) {
+    size_t size = 0;
+    const CTRDLSymAddr* symAddrs = handle ? ctrdl_getSymAddrs(handle, &size) : NULL;
+    if (!symAddrs)
+        return NULL;
+
+    // Find the last symbol starting at or before the value.
+    size_t low = 0;
+    size_t high = size;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        if (symAddrs[mid].addr <= value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low ? &handle->symTable.symEntries[symAddrs[low - 1].index] : NULL;
 }
\ No newline at end of file
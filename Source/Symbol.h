@@ -9,9 +9,32 @@
 
 #include "Handle.h"
 
-const Elf32_Sym* ctrdl_symNameLookupSingle(CTRDLHandle* handle, const char* name);
-const Elf32_Sym* ctrdl_symNameLookupLoadOrder(CTRDLHandle* handle, const char* name, u32* modBase);
-const Elf32_Sym* ctrdl_symNameLookupDepOrder(CTRDLHandle* handle, const char* name);
+typedef struct {
+    CTRDLSymKey key;      // Symbol key.
+    const Elf32_Sym* sym; // Resolved symbol, NULL if missing.
+    u32 modBase;          // Base of the object defining the symbol.
+} CTRDLSymBatchEntry;
+
+// Lookups cache the SysV hash in the key, which belongs to a single thread.
+// Callers hold a reference to the handle, which keeps its dependencies loaded.
+const Elf32_Sym* ctrdl_symNameLookupSingle(CTRDLHandle* handle, CTRDLSymKey* key);
+// Lock-free, lookups are cached until objects are loaded, unloaded or promoted to RTLD_GLOBAL.
+// Global objects are not held, symbols must be used within a read section of the caller.
+const Elf32_Sym* ctrdl_symNameLookupGlobal(CTRDLSymKey* key, u32* modBase);
+
+// Load order is depth first, dependency order is breadth first, init order is depth first post-order.
+// Every object appears once in each scope, builds are serialized.
+CTRDLScopes* ctrdl_makeScopes(CTRDLHandle* handle);
+
+// Lock-free, the flattened scopes of the handle are searched.
+const Elf32_Sym* ctrdl_symNameLookupLoadOrder(CTRDLHandle* handle, CTRDLSymKey* key, u32* modBase);
+const Elf32_Sym* ctrdl_symNameLookupDepOrder(CTRDLHandle* handle, CTRDLSymKey* key, u32* modBase);
+
+// Scopes are walked once for all entries, resolved entries are skipped; returns the number of missing symbols.
+size_t ctrdl_symNameLookupGlobalBatch(CTRDLSymBatchEntry* entries, size_t count);
+size_t ctrdl_symNameLookupDepOrderBatch(CTRDLHandle* handle, CTRDLSymBatchEntry* entries, size_t count);
+
+// Returns the nearest symbol at or before the value, the handle must be locked.
 const Elf32_Sym* ctrdl_symValueLookupSingle(CTRDLHandle* handle, Elf32_Word value);
 
 #endif /* _CTRDL_SYMBOL_H */
\ No newline at end of file
@@ -0,0 +1,230 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Worker.h"
+
+#ifndef CTRDL_DEFAULT_WORKERS
+#define CTRDL_DEFAULT_WORKERS 0
+#endif // CTRDL_DEFAULT_WORKERS
+
+#define CTRDL_WORKER_STACK_SIZE 0x4000
+
+typedef struct {
+    LightLock lock;
+    CondVar cond;
+    CTRDLJob* head;
+    CTRDLJob* tail;
+    Thread threads[CTRDL_MAX_WORKERS];
+    size_t numThreads;
+    size_t numWanted;
+    bool exit;
+} WorkerPool;
+
+static WorkerPool g_Pool = { .numWanted = CTRDL_DEFAULT_WORKERS };
+static LightLock g_ConfigLock;
+
+static void ctrdl_poolLazyInit(void) {
+    static u8 initialized = 0;
+
+    if (!__ldrexb(&initialized)) {
+        LightLock_Init(&g_Pool.lock);
+        CondVar_Init(&g_Pool.cond);
+        LightLock_Init(&g_ConfigLock);
+
+        while (__strexb(&initialized, 1))
+            __ldrexb(&initialized);
+    } else {
+        __clrex();
+    }
+}
+
+static void ctrdl_runJob(CTRDLJob* job) {
+    job->fn(job->arg);
+
+    // The group may go away as soon as the job is returned, don't touch it after unlocking.
+    CTRDLJobGroup* group = job->group;
+    LightLock_Lock(&group->lock);
+
+    job->next = NULL;
+    if (group->doneTail) {
+        group->doneTail->next = job;
+    } else {
+        group->doneHead = job;
+    }
+
+    group->doneTail = job;
+    CondVar_Signal(&group->cond);
+    LightLock_Unlock(&group->lock);
+}
+
+// Assumes the pool lock is held.
+static CTRDLJob* ctrdl_popJob(void) {
+    CTRDLJob* job = g_Pool.head;
+    if (job) {
+        g_Pool.head = job->next;
+        if (!g_Pool.head)
+            g_Pool.tail = NULL;
+    }
+
+    return job;
+}
+
+static void ctrdl_workerMain(void* arg) {
+    (void)arg;
+    LightLock_Lock(&g_Pool.lock);
+
+    for (;;) {
+        while (!g_Pool.head && !g_Pool.exit)
+            CondVar_Wait(&g_Pool.cond, &g_Pool.lock);
+
+        // Queued jobs are drained before exiting.
+        CTRDLJob* job = ctrdl_popJob();
+        if (!job)
+            break;
+
+        LightLock_Unlock(&g_Pool.lock);
+        ctrdl_runJob(job);
+        LightLock_Lock(&g_Pool.lock);
+    }
+
+    LightLock_Unlock(&g_Pool.lock);
+}
+
+static void ctrdl_stopWorkers(void) {
+    LightLock_Lock(&g_Pool.lock);
+    g_Pool.exit = true;
+    CondVar_Broadcast(&g_Pool.cond);
+    LightLock_Unlock(&g_Pool.lock);
+
+    for (size_t i = 0; i < g_Pool.numThreads; ++i) {
+        threadJoin(g_Pool.threads[i], U64_MAX);
+        threadFree(g_Pool.threads[i]);
+    }
+
+    LightLock_Lock(&g_Pool.lock);
+    g_Pool.numThreads = 0;
+    g_Pool.exit = false;
+
+    // Jobs queued while the last worker was exiting.
+    CTRDLJob* job;
+    while ((job = ctrdl_popJob())) {
+        LightLock_Unlock(&g_Pool.lock);
+        ctrdl_runJob(job);
+        LightLock_Lock(&g_Pool.lock);
+    }
+
+    LightLock_Unlock(&g_Pool.lock);
+}
+
+// Assumes the config lock is held.
+static bool ctrdl_startWorkers(size_t numWorkers) {
+    // Workers inherit the priority of the thread that starts them.
+    s32 priority = 0x30;
+    svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+
+    size_t numThreads = 0;
+    while (numThreads < numWorkers) {
+        Thread t = threadCreate(ctrdl_workerMain, NULL, CTRDL_WORKER_STACK_SIZE, priority, -2, false);
+        if (!t)
+            break;
+
+        g_Pool.threads[numThreads++] = t;
+    }
+
+    LightLock_Lock(&g_Pool.lock);
+    g_Pool.numThreads = numThreads;
+    LightLock_Unlock(&g_Pool.lock);
+    return numThreads == numWorkers;
+}
+
+bool ctrdl_setNumWorkers(size_t numWorkers) {
+    if (numWorkers > CTRDL_MAX_WORKERS)
+        return false;
+
+    ctrdl_poolLazyInit();
+    LightLock_Lock(&g_ConfigLock);
+
+    // Threads are started on first use.
+    ctrdl_stopWorkers();
+    g_Pool.numWanted = numWorkers;
+
+    LightLock_Unlock(&g_ConfigLock);
+    return true;
+}
+
+size_t ctrdl_getNumWorkers(void) {
+    ctrdl_poolLazyInit();
+    LightLock_Lock(&g_ConfigLock);
+    const size_t numWorkers = g_Pool.numWanted;
+    LightLock_Unlock(&g_ConfigLock);
+    return numWorkers;
+}
+
+void ctrdl_jobGroupInit(CTRDLJobGroup* group) {
+    LightLock_Init(&group->lock);
+    CondVar_Init(&group->cond);
+    group->doneHead = NULL;
+    group->doneTail = NULL;
+    group->numPending = 0;
+}
+
+void ctrdl_jobSubmit(CTRDLJobGroup* group, CTRDLJob* job, CTRDLJobFn fn, void* arg) {
+    job->fn = fn;
+    job->arg = arg;
+    job->next = NULL;
+    job->group = group;
+
+    LightLock_Lock(&group->lock);
+    ++group->numPending;
+    LightLock_Unlock(&group->lock);
+
+    ctrdl_poolLazyInit();
+    LightLock_Lock(&g_ConfigLock);
+
+    if (g_Pool.numWanted && !g_Pool.numThreads)
+        ctrdl_startWorkers(g_Pool.numWanted);
+
+    LightLock_Lock(&g_Pool.lock);
+    const bool hasWorkers = g_Pool.numThreads != 0;
+
+    if (hasWorkers) {
+        if (g_Pool.tail) {
+            g_Pool.tail->next = job;
+        } else {
+            g_Pool.head = job;
+        }
+
+        g_Pool.tail = job;
+        CondVar_Signal(&g_Pool.cond);
+    }
+
+    LightLock_Unlock(&g_Pool.lock);
+    LightLock_Unlock(&g_ConfigLock);
+
+    // Deterministic mode, jobs complete in submission order.
+    if (!hasWorkers)
+        ctrdl_runJob(job);
+}
+
+CTRDLJob* ctrdl_jobGroupWait(CTRDLJobGroup* group) {
+    CTRDLJob* job = NULL;
+    LightLock_Lock(&group->lock);
+
+    if (group->numPending) {
+        while (!group->doneHead)
+            CondVar_Wait(&group->cond, &group->lock);
+
+        job = group->doneHead;
+        group->doneHead = job->next;
+        if (!group->doneHead)
+            group->doneTail = NULL;
+
+        --group->numPending;
+    }
+
+    LightLock_Unlock(&group->lock);
+    return job;
+}
@@ -0,0 +1,43 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _CTRDL_WORKER_H
+#define _CTRDL_WORKER_H
+
+#include <dlfcn.h>
+
+#define CTRDL_MAX_WORKERS 4
+
+typedef void(*CTRDLJobFn)(void* arg);
+
+struct CTRDLJobGroup;
+
+typedef struct CTRDLJob {
+    CTRDLJobFn fn;               // Job function.
+    void* arg;                   // Job argument.
+    struct CTRDLJob* next;       // Next job in the queue.
+    struct CTRDLJobGroup* group; // Group the job is reported to.
+} CTRDLJob;
+
+typedef struct CTRDLJobGroup {
+    LightLock lock;
+    CondVar cond;
+    CTRDLJob* doneHead; // Completed jobs, in completion order.
+    CTRDLJob* doneTail;
+    size_t numPending;  // Jobs submitted and not yet returned by ctrdl_jobGroupWait.
+} CTRDLJobGroup;
+
+// With no workers, jobs run on the calling thread as soon as they are submitted.
+bool ctrdl_setNumWorkers(size_t numWorkers);
+size_t ctrdl_getNumWorkers(void);
+
+void ctrdl_jobGroupInit(CTRDLJobGroup* group);
+void ctrdl_jobSubmit(CTRDLJobGroup* group, CTRDLJob* job, CTRDLJobFn fn, void* arg);
+
+// Returns the next completed job, or NULL if none is pending.
+CTRDLJob* ctrdl_jobGroupWait(CTRDLJobGroup* group);
+
+#endif /* _CTRDL_WORKER_H */
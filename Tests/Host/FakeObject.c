@@ -0,0 +1,122 @@
+#include "FakeObject.h"
+#include "Symbol.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Objects must be addressable with 32 bits, as on the 3DS.
+static Image* allocImage(void) {
+#ifdef MAP_32BIT
+    void* p = mmap(NULL, sizeof(Image), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    return (p != MAP_FAILED) ? p : NULL;
+#else
+    _Static_assert(sizeof(void*) == sizeof(u32), "objects can't be addressed with 32 bits");
+    return calloc(1, sizeof(Image));
+#endif
+}
+
+static void freeImage(Image* image) {
+#ifdef MAP_32BIT
+    munmap(image, sizeof(Image));
+#else
+    free(image);
+#endif
+}
+
+bool ctrdl_unloadObject(CTRDLHandle* handle) {
+    ctrdl_unsafeUnpublishHandle(handle);
+
+    // Readers still looking at the image would see the poison, or trip the sanitizer.
+    Image* image = (Image*)(uintptr_t)handle->base;
+    if (image) {
+        memset(image, 0xDD, sizeof(Image));
+        freeImage(image);
+        handle->base = 0;
+    }
+
+    for (size_t i = 0; i < handle->numDeps; ++i) {
+        if (handle->deps[i])
+            ctrdl_unlockHandle(handle->deps[i]);
+    }
+
+    free(handle->deps);
+    handle->deps = NULL;
+    handle->numDeps = 0;
+
+    memset(&handle->symTable, 0, sizeof(CTRDLSymTable));
+    free(handle->scopes);
+    handle->scopes = NULL;
+    free(handle->symAddrs);
+    handle->symAddrs = NULL;
+    handle->numSymAddrs = 0;
+    return true;
+}
+
+CTRDLHandle* loadFakeObject(u32 id, size_t flags, CTRDLHandle* const* deps, size_t numDeps) {
+    char name[32];
+    snprintf(name, sizeof(name), "sdmc:/obj%u.so", id);
+
+    char* path = ctrdl_canonicalizePath(name);
+    if (!path)
+        return NULL;
+
+    CTRDLHandle* h = ctrdl_createHandle(path, ctrdl_hashPath(path), flags);
+    free(path);
+    if (!h)
+        return NULL;
+
+    if (numDeps) {
+        h->deps = malloc(numDeps * sizeof(CTRDLHandle*));
+        if (!h->deps) {
+            ctrdl_unlockHandle(h);
+            return NULL;
+        }
+
+        for (size_t i = 0; i < numDeps; ++i) {
+            ctrdl_lockHandle(deps[i]);
+            h->deps[i] = deps[i];
+        }
+
+        h->numDeps = numDeps;
+    }
+
+    Image* image = allocImage();
+    if (!image) {
+        ctrdl_unlockHandle(h);
+        return NULL;
+    }
+
+    buildImage(image, id);
+
+    h->base = (u32)(uintptr_t)image;
+    h->size = sizeof(Image);
+    h->symTable.numSymBuckets = image->hash[0];
+    h->symTable.symBuckets = &image->hash[2];
+    h->symTable.symChains = &image->hash[2 + image->hash[0]];
+    h->symTable.numSymEntries = image->hash[1];
+    h->symTable.symEntries = image->syms;
+    h->symTable.stringTable = image->strings;
+    h->symTable.stringTableSize = sizeof(image->strings);
+
+    h->scopes = ctrdl_makeScopes(h);
+    if (!h->scopes) {
+        ctrdl_unlockHandle(h);
+        return NULL;
+    }
+
+    ctrdl_acquireHandleMtx();
+    const bool inserted = ctrdl_unsafeInsertAddrRange(h, h->base, h->base + h->size);
+    if (inserted)
+        ctrdl_unsafePublishHandle(h);
+    ctrdl_releaseHandleMtx();
+
+    if (!inserted) {
+        ctrdl_unlockHandle(h);
+        return NULL;
+    }
+
+    return h;
+}
@@ -0,0 +1,10 @@
+#ifndef _FAKE_OBJECT_H
+#define _FAKE_OBJECT_H
+
+#include "Handle.h"
+#include "Image.h"
+
+// Images are published as they are, without going through the loader; they are poisoned and freed on unload, dependencies are locked.
+CTRDLHandle* loadFakeObject(u32 id, size_t flags, CTRDLHandle* const* deps, size_t numDeps);
+
+#endif /* _FAKE_OBJECT_H */
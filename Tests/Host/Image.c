@@ -0,0 +1,79 @@
+#include "Image.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+void makeUniqueName(char* out, size_t size, u32 id) { snprintf(out, size, "sym_%u", id); }
+
+void buildImage(Image* image, u32 id) {
+    memset(image, 0, sizeof(Image));
+
+    Elf32_Ehdr* header = &image->header;
+    memcpy(header->e_ident, ELFMAG, SELFMAG);
+    header->e_ident[EI_CLASS] = ELFCLASS32;
+    header->e_ident[EI_DATA] = ELFDATA2LSB;
+    header->e_ident[EI_VERSION] = EV_CURRENT;
+    header->e_type = ET_DYN;
+    header->e_machine = EM_ARM;
+    header->e_version = EV_CURRENT;
+    header->e_phoff = offsetof(Image, segments);
+    header->e_ehsize = sizeof(Elf32_Ehdr);
+    header->e_phentsize = sizeof(Elf32_Phdr);
+    header->e_phnum = 2;
+
+    // The file is loaded as is, addresses are file offsets.
+    Elf32_Phdr* load = &image->segments[0];
+    load->p_type = PT_LOAD;
+    load->p_filesz = sizeof(Image);
+    load->p_memsz = sizeof(Image);
+    load->p_flags = PF_R | PF_W;
+    load->p_align = 0x1000;
+
+    Elf32_Phdr* dynamic = &image->segments[1];
+    dynamic->p_type = PT_DYNAMIC;
+    dynamic->p_offset = offsetof(Image, dyn);
+    dynamic->p_vaddr = offsetof(Image, dyn);
+    dynamic->p_filesz = sizeof(image->dyn);
+    dynamic->p_memsz = sizeof(image->dyn);
+    dynamic->p_flags = PF_R | PF_W;
+    dynamic->p_align = sizeof(Elf32_Word);
+
+    image->dyn[0].d_tag = DT_HASH;
+    image->dyn[0].d_un.d_ptr = offsetof(Image, hash);
+    image->dyn[1].d_tag = DT_SYMTAB;
+    image->dyn[1].d_un.d_ptr = offsetof(Image, syms);
+    image->dyn[2].d_tag = DT_STRTAB;
+    image->dyn[2].d_un.d_ptr = offsetof(Image, strings);
+    image->dyn[3].d_tag = DT_STRSZ;
+    image->dyn[3].d_un.d_val = sizeof(image->strings);
+    image->dyn[4].d_tag = DT_SYMENT;
+    image->dyn[4].d_un.d_val = sizeof(Elf32_Sym);
+    image->dyn[5].d_tag = DT_NULL;
+
+    // "shared" is defined by every object, the other name is unique.
+    strcpy(&image->strings[1], "shared");
+    makeUniqueName(&image->strings[8], sizeof(image->strings) - 8, id);
+
+    image->syms[1].st_name = 1;
+    image->syms[1].st_value = offsetof(Image, data);
+    image->syms[1].st_size = 8;
+    image->syms[1].st_info = ELF32_ST_INFO(STB_GLOBAL, STT_OBJECT);
+    image->syms[1].st_shndx = 1;
+
+    image->syms[2].st_name = 8;
+    image->syms[2].st_value = offsetof(Image, data) + 8;
+    image->syms[2].st_size = 8;
+    image->syms[2].st_info = ELF32_ST_INFO(STB_GLOBAL, STT_OBJECT);
+    image->syms[2].st_shndx = 1;
+
+    // Only a SysV table, a single bucket chains every symbol.
+    image->hash[0] = 1;
+    image->hash[1] = 3;
+    image->hash[2] = 2;
+    image->hash[3 + 2] = 1;
+    image->hash[3 + 1] = STN_UNDEF;
+
+    image->magic = IMAGE_MAGIC;
+    image->id = id;
+}
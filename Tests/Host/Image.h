@@ -0,0 +1,25 @@
+#ifndef _IMAGE_H
+#define _IMAGE_H
+
+#include <3ds.h>
+#include <elf.h>
+
+#define IMAGE_MAGIC 0x7510BEEF
+
+// Objects are minimal shared objects, defining "shared" and "sym_<id>" in data.
+typedef struct {
+    Elf32_Ehdr header;
+    Elf32_Phdr segments[2];
+    Elf32_Dyn dyn[6];
+    Elf32_Word hash[2 + 1 + 3]; // One bucket, three chains.
+    Elf32_Sym syms[3];
+    char strings[32];
+    u32 magic;
+    u32 id;
+    u32 data[4];
+} Image;
+
+void makeUniqueName(char* out, size_t size, u32 id);
+void buildImage(Image* image, u32 id);
+
+#endif /* _IMAGE_H */
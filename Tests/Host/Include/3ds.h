@@ -0,0 +1,174 @@
+#ifndef _CTRDL_HOST_3DS_H
+#define _CTRDL_HOST_3DS_H
+
+// Host stand-in for the parts of libctru used by the library, addresses of objects must fit in 32 bits.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef s32 Result;
+
+#define R_SUCCEEDED(res) ((res) >= 0)
+#define R_FAILED(res) ((res) < 0)
+
+#define U64_MAX UINT64_MAX
+#define CUR_THREAD_HANDLE 0xFFFF8000
+#define SYSCLOCK_ARM11 268111856LL
+
+typedef enum {
+    MEMPERM_READ = 1,
+    MEMPERM_WRITE = 2,
+    MEMPERM_EXECUTE = 4,
+    MEMPERM_READWRITE = MEMPERM_READ | MEMPERM_WRITE,
+    MEMPERM_READEXECUTE = MEMPERM_READ | MEMPERM_EXECUTE,
+    MEMPERM_DONTCARE = 0x10000000,
+} MemPerm;
+
+typedef pthread_mutex_t RecursiveLock;
+
+static inline void RecursiveLock_Init(RecursiveLock* lock) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static inline void RecursiveLock_Lock(RecursiveLock* lock) { pthread_mutex_lock(lock); }
+static inline void RecursiveLock_Unlock(RecursiveLock* lock) { pthread_mutex_unlock(lock); }
+
+typedef pthread_mutex_t LightLock;
+
+static inline void LightLock_Init(LightLock* lock) { pthread_mutex_init(lock, NULL); }
+static inline void LightLock_Lock(LightLock* lock) { pthread_mutex_lock(lock); }
+static inline void LightLock_Unlock(LightLock* lock) { pthread_mutex_unlock(lock); }
+
+typedef pthread_cond_t CondVar;
+
+static inline void CondVar_Init(CondVar* cv) { pthread_cond_init(cv, NULL); }
+static inline void CondVar_Wait(CondVar* cv, LightLock* lock) { pthread_cond_wait(cv, lock); }
+static inline void CondVar_Signal(CondVar* cv) { pthread_cond_signal(cv); }
+static inline void CondVar_Broadcast(CondVar* cv) { pthread_cond_broadcast(cv); }
+
+typedef enum {
+    RESET_ONESHOT = 0,
+    RESET_STICKY = 1,
+    RESET_PULSE = 2,
+} ResetType;
+
+// Only sticky events are used.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool signaled;
+} LightEvent;
+
+static inline void LightEvent_Init(LightEvent* event, ResetType type) {
+    pthread_mutex_init(&event->lock, NULL);
+    pthread_cond_init(&event->cond, NULL);
+    event->signaled = false;
+}
+
+static inline void LightEvent_Signal(LightEvent* event) {
+    pthread_mutex_lock(&event->lock);
+    event->signaled = true;
+    pthread_cond_broadcast(&event->cond);
+    pthread_mutex_unlock(&event->lock);
+}
+
+static inline int LightEvent_TryWait(LightEvent* event) {
+    pthread_mutex_lock(&event->lock);
+    const bool signaled = event->signaled;
+    pthread_mutex_unlock(&event->lock);
+    return signaled;
+}
+
+static inline void LightEvent_Wait(LightEvent* event) {
+    pthread_mutex_lock(&event->lock);
+    while (!event->signaled)
+        pthread_cond_wait(&event->cond, &event->lock);
+    pthread_mutex_unlock(&event->lock);
+}
+
+typedef void (*ThreadFunc)(void*);
+
+typedef struct {
+    pthread_t thread;
+    ThreadFunc entry;
+    void* arg;
+} *Thread;
+
+static inline void* _ctrdl_hostThreadMain(void* arg) {
+    Thread t = (Thread)arg;
+    t->entry(t->arg);
+    return NULL;
+}
+
+// Stack size, priority and core are ignored.
+static inline Thread threadCreate(ThreadFunc entry, void* arg, size_t stackSize, int prio, int core, bool detached) {
+    Thread t = (Thread)malloc(sizeof(*t));
+    if (!t)
+        return NULL;
+
+    t->entry = entry;
+    t->arg = arg;
+    if (pthread_create(&t->thread, NULL, _ctrdl_hostThreadMain, t)) {
+        free(t);
+        return NULL;
+    }
+
+    return t;
+}
+
+static inline Result threadJoin(Thread t, u64 timeout) { return pthread_join(t->thread, NULL) ? -1 : 0; }
+static inline void threadFree(Thread t) { free(t); }
+
+static inline Result svcGetThreadPriority(s32* out, u32 handle) {
+    *out = 0x30;
+    return 0;
+}
+
+static inline void svcSleepThread(s64 ns) {
+    const struct timespec ts = { ns / 1000000000, ns % 1000000000 };
+    nanosleep(&ts, NULL);
+}
+
+// Ticks at the ARM11 clock rate, from a monotonic clock.
+static inline u64 svcGetSystemTick(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * SYSCLOCK_ARM11 + ((u64)ts.tv_nsec * SYSCLOCK_ARM11) / 1000000000;
+}
+
+typedef enum {
+    USERBREAK_PANIC = 0,
+    USERBREAK_ASSERT = 1,
+    USERBREAK_USER = 2,
+} UserBreakType;
+
+static inline void svcBreak(UserBreakType type) { abort(); }
+
+// Exclusive stores always succeed, lazy initialization must happen before other threads are started.
+static inline u8 __ldrexb(volatile u8* addr) { return __atomic_load_n(addr, __ATOMIC_ACQUIRE); }
+
+static inline int __strexb(volatile u8* addr, u8 val) {
+    __atomic_store_n(addr, val, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static inline void __clrex(void) {}
+
+#endif /* _CTRDL_HOST_3DS_H */
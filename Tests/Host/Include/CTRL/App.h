@@ -0,0 +1,22 @@
+#ifndef _CTRDL_HOST_CTRL_APP_H
+#define _CTRDL_HOST_CTRL_APP_H
+
+// Host stand-in for CTRL app info, there is no program image.
+
+#include <3ds.h>
+
+typedef struct {
+    u32 textAddr;
+    size_t textSize;
+    u32 rodataAddr;
+    size_t rodataSize;
+    u32 dataAddr;
+    size_t dataSize;
+} CTRLAppSectionInfo;
+
+static inline const CTRLAppSectionInfo* ctrlAppSectionInfo(void) {
+    static const CTRLAppSectionInfo info = {};
+    return &info;
+}
+
+#endif /* _CTRDL_HOST_CTRL_APP_H */
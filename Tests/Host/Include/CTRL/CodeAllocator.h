@@ -0,0 +1,43 @@
+#ifndef _CTRDL_HOST_CTRL_CODEALLOCATOR_H
+#define _CTRDL_HOST_CTRL_CODEALLOCATOR_H
+
+// Host stand-in for the CTRL code allocator, pages are mapped in the low 4GB and never mirrored.
+
+#include <CTRL/Memory.h>
+
+#ifdef MAP_32BIT
+#define _CTRDL_HOST_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT)
+#else
+#define _CTRDL_HOST_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS)
+#endif // MAP_32BIT
+
+static inline Result ctrlAllocCodePages(size_t numPages, u32* out) {
+    const size_t size = ctrlNumPagesToSize(numPages);
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, _CTRDL_HOST_MAP_FLAGS, -1, 0);
+    if (p == MAP_FAILED)
+        return -1;
+
+    // Addresses are u32 in the library.
+    if (((uintptr_t)p + size) > UINT32_MAX) {
+        munmap(p, size);
+        return -1;
+    }
+
+    *out = (u32)(uintptr_t)p;
+    return 0;
+}
+
+static inline Result ctrlFreeCodePages(u32 addr, size_t numPages) {
+    return munmap((void*)(uintptr_t)addr, ctrlNumPagesToSize(numPages)) ? -1 : 0;
+}
+
+static inline Result ctrlCommitCodePages(u32 origin, size_t numPages, u32* out) {
+    *out = origin;
+    return 0;
+}
+
+static inline Result ctrlReleaseCodePages(u32 origin, u32 base, size_t numPages) {
+    return ctrlChangeMemoryPerms(base, ctrlNumPagesToSize(numPages), MEMPERM_READWRITE);
+}
+
+#endif /* _CTRDL_HOST_CTRL_CODEALLOCATOR_H */
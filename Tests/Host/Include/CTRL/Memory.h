@@ -0,0 +1,36 @@
+#ifndef _CTRDL_HOST_CTRL_MEMORY_H
+#define _CTRDL_HOST_CTRL_MEMORY_H
+
+// Host stand-in for the parts of CTRL used by the library, backed by mmap and mprotect.
+
+#include <3ds.h>
+
+#include <sys/mman.h>
+
+#define CTRL_PAGE_SIZE 0x1000
+
+static inline u32 ctrlAlignUp(u32 v, u32 alignment) { return (v + alignment - 1) & ~(alignment - 1); }
+static inline u32 ctrlAlignDown(u32 v, u32 alignment) { return v & ~(alignment - 1); }
+static inline size_t ctrlSizeToNumPages(size_t size) { return ctrlAlignUp(size, CTRL_PAGE_SIZE) / CTRL_PAGE_SIZE; }
+static inline size_t ctrlNumPagesToSize(size_t numPages) { return numPages * CTRL_PAGE_SIZE; }
+
+static inline Result ctrlChangeMemoryPerms(u32 addr, size_t size, MemPerm perms) {
+    int prot = PROT_NONE;
+    if (perms & MEMPERM_READ)
+        prot |= PROT_READ;
+
+    if (perms & MEMPERM_WRITE)
+        prot |= PROT_WRITE;
+
+    if (perms & MEMPERM_EXECUTE)
+        prot |= PROT_EXEC;
+
+    const u32 begin = ctrlAlignDown(addr, CTRL_PAGE_SIZE);
+    return mprotect((void*)(uintptr_t)begin, ctrlAlignUp(addr + size, CTRL_PAGE_SIZE) - begin, prot) ? -1 : 0;
+}
+
+// Code is never run on the host.
+static inline void ctrlFlushDataCache(void) {}
+static inline void ctrlInvalidateInstructionCache(void) {}
+
+#endif /* _CTRDL_HOST_CTRL_MEMORY_H */
@@ -0,0 +1,405 @@
+#include "Handle.h"
+#include "Relocs.h"
+
+#include <CTRL/CodeAllocator.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 100
+#define IMPORT_ADDR 0x1000 // Imports resolve here, object code is never run.
+
+typedef struct {
+    const char** names; // Undefined symbols, sorted.
+    size_t count;
+} Imports;
+
+typedef struct {
+    const char** names; // Defined symbols.
+    Elf32_Addr* values; // Symbol values.
+    size_t count;
+} Exports;
+
+typedef struct {
+    u64* samples;
+    size_t count;
+} Timing;
+
+typedef struct {
+    const char* path;
+    u8* buffer;
+    size_t size;
+    u32 image;        // Segments laid out at their addresses, never relocated.
+    size_t numPages;
+    Imports imports;
+    Exports exports;
+    size_t numRelocs;
+    Timing parse;
+    Timing relocate;
+    Timing openClose;
+    Timing dlsym;
+    Timing dladdr;
+#ifdef CTRDL_LOAD_STATS
+    CTRDLLoadStats loadStats; // Of the object mapped for lookups.
+#endif // CTRDL_LOAD_STATS
+} Object;
+
+static size_t g_Iterations = DEFAULT_ITERATIONS;
+
+static u64 nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+static int compareNames(const void* a, const void* b) { return strcmp(*(const char* const*)a, *(const char* const*)b); }
+static int compareSamples(const void* a, const void* b) { return (*(const u64*)a > *(const u64*)b) - (*(const u64*)a < *(const u64*)b); }
+
+// Dependencies are not loaded on the host, their symbols are stubbed.
+static void* benchResolver(const char* sym, void* userData) {
+    const Imports* imports = (const Imports*)userData;
+    return bsearch(&sym, imports->names, imports->count, sizeof(const char*), compareNames) ? (void*)IMPORT_ADDR : NULL;
+}
+
+static bool readFile(Object* obj) {
+    FILE* f = fopen(obj->path, "rb");
+    if (!f)
+        return false;
+
+    bool success = !fseek(f, 0, SEEK_END);
+    const long size = success ? ftell(f) : -1;
+    success = (size > 0) && !fseek(f, 0, SEEK_SET);
+
+    if (success) {
+        obj->size = size;
+        obj->buffer = malloc(obj->size);
+        success = obj->buffer && (fread(obj->buffer, 1, obj->size, f) == obj->size);
+    }
+
+    fclose(f);
+    return success;
+}
+
+static bool parseObject(Object* obj, CTRDLElf* elf) {
+    CTRDLStream stream;
+    ctrdl_makeMemStream(&stream, obj->buffer, obj->size);
+    return ctrdl_parseELF(&stream, elf);
+}
+
+static size_t getImageSize(CTRDLElf* elf) {
+    size_t size = 0;
+    for (size_t i = 0; i < elf->header.e_phnum; ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if ((segment->p_type == PT_LOAD) && ((segment->p_vaddr + segment->p_memsz) > size))
+            size = segment->p_vaddr + segment->p_memsz;
+    }
+
+    return size;
+}
+
+static bool copySegments(Object* obj, CTRDLElf* elf, u32 image) {
+    memset((void*)(uintptr_t)image, 0, ctrlNumPagesToSize(obj->numPages));
+
+    for (size_t i = 0; i < elf->header.e_phnum; ++i) {
+        const Elf32_Phdr* segment = &elf->segments[i];
+        if (segment->p_type != PT_LOAD)
+            continue;
+
+        if ((segment->p_offset + segment->p_filesz) > obj->size)
+            return false;
+
+        memcpy((void*)(uintptr_t)(image + segment->p_vaddr), obj->buffer + segment->p_offset, segment->p_filesz);
+    }
+
+    return true;
+}
+
+// Tables are read from an unrelocated copy of the image.
+static bool prepareObject(Object* obj) {
+    CTRDLElf elf;
+    if (!parseObject(obj, &elf))
+        return false;
+
+    obj->numPages = ctrlSizeToNumPages(getImageSize(&elf));
+    bool success = obj->numPages && R_SUCCEEDED(ctrlAllocCodePages(obj->numPages, &obj->image)) && copySegments(obj, &elf, obj->image);
+    if (success)
+        success = ctrdl_bindELFTables(&elf, obj->image);
+
+    const CTRDLSymTable* table = &elf.symTable;
+    if (success) {
+        obj->imports.names = calloc(table->numSymEntries, sizeof(const char*));
+        obj->exports.names = calloc(table->numSymEntries, sizeof(const char*));
+        obj->exports.values = calloc(table->numSymEntries, sizeof(Elf32_Addr));
+        success = obj->imports.names && obj->exports.names && obj->exports.values;
+    }
+
+    for (size_t i = 1; success && (i < table->numSymEntries); ++i) {
+        const Elf32_Sym* sym = &table->symEntries[i];
+        if ((ELF32_ST_BIND(sym->st_info) == STB_LOCAL) || !sym->st_name || (sym->st_name >= table->stringTableSize))
+            continue;
+
+        const char* name = &table->stringTable[sym->st_name];
+        if (sym->st_shndx == SHN_UNDEF) {
+            obj->imports.names[obj->imports.count++] = name;
+        } else if (ELF32_ST_TYPE(sym->st_info) != STT_TLS) {
+            obj->exports.names[obj->exports.count] = name;
+            obj->exports.values[obj->exports.count++] = sym->st_value;
+        }
+    }
+
+    if (success)
+        qsort(obj->imports.names, obj->imports.count, sizeof(const char*), compareNames);
+
+    ctrdl_freeELF(&elf);
+    return success;
+}
+
+static void addSample(Timing* t, u64 ns) { t->samples[t->count++] = ns; }
+
+static bool benchParse(Object* obj) {
+    for (size_t i = 0; i < g_Iterations; ++i) {
+        CTRDLElf elf;
+        const u64 begin = nowNs();
+        const bool success = parseObject(obj, &elf);
+        if (success)
+            ctrdl_freeELF(&elf);
+
+        addSample(&obj->parse, nowNs() - begin);
+        if (!success)
+            return false;
+    }
+
+    return true;
+}
+
+// Relocations are applied to a fresh copy of the image each time, only the relocation step is timed.
+static bool benchRelocate(Object* obj) {
+    for (size_t i = 0; i < g_Iterations; ++i) {
+        CTRDLElf elf;
+        if (!parseObject(obj, &elf))
+            return false;
+
+        CTRDLHandle* handle = ctrdl_createHandle(NULL, 0, RTLD_NOW | RTLD_LOCAL);
+        bool success = handle && R_SUCCEEDED(ctrlAllocCodePages(obj->numPages, &handle->origin));
+        if (success) {
+            handle->base = handle->origin;
+            handle->numPages = obj->numPages;
+            success = copySegments(obj, &elf, handle->base) && ctrdl_bindELFTables(&elf, handle->base);
+        }
+
+        if (success) {
+            handle->symTable = elf.symTable;
+
+            const u64 begin = nowNs();
+            success = ctrdl_handleRelocs(handle, &elf, benchResolver, &obj->imports);
+            addSample(&obj->relocate, nowNs() - begin);
+        }
+
+        ctrdl_freeELF(&elf);
+        if (handle)
+            ctrdl_unlockHandle(handle);
+
+        if (!success)
+            return false;
+    }
+
+    return true;
+}
+
+static bool benchOpenClose(Object* obj) {
+    for (size_t i = 0; i < g_Iterations; ++i) {
+        const u64 begin = nowNs();
+        void* handle = ctrdlMap(obj->buffer, obj->size, RTLD_NOW | RTLD_LOCAL, benchResolver, &obj->imports);
+        const bool success = handle && !dlclose(handle);
+        addSample(&obj->openClose, nowNs() - begin);
+        if (!success)
+            return false;
+    }
+
+    return true;
+}
+
+// Samples are averaged over every defined symbol.
+static bool benchLookups(Object* obj) {
+    void* handle = ctrdlMap(obj->buffer, obj->size, RTLD_NOW | RTLD_LOCAL, benchResolver, &obj->imports);
+    if (!handle)
+        return false;
+
+    CTRDLInfo info;
+    bool success = ctrdlInfo(handle, &info);
+    if (success) {
+        obj->numRelocs = info.numRelocs;
+        ctrdlFreeInfo(&info);
+    }
+
+#ifdef CTRDL_LOAD_STATS
+    success = success && ctrdlGetLoadStats(handle, &obj->loadStats);
+#endif // CTRDL_LOAD_STATS
+
+    const size_t count = obj->exports.count;
+    for (size_t i = 0; success && count && (i < g_Iterations); ++i) {
+        u64 begin = nowNs();
+        for (size_t j = 0; j < count; ++j)
+            success &= dlsym(handle, obj->exports.names[j]) != NULL;
+
+        addSample(&obj->dlsym, (nowNs() - begin) / count);
+
+        begin = nowNs();
+        for (size_t j = 0; j < count; ++j) {
+            Dl_info dlInfo;
+            success &= dladdr((void*)(uintptr_t)(info.base + obj->exports.values[j]), &dlInfo) != 0;
+        }
+
+        addSample(&obj->dladdr, (nowNs() - begin) / count);
+    }
+
+    return !dlclose(handle) && success;
+}
+
+static void printString(const char* s) {
+    putchar('"');
+    for (; *s; ++s) {
+        if ((*s == '"') || (*s == '\\')) {
+            printf("\\%c", *s);
+        } else if ((u8)*s < 0x20) {
+            printf("\\u%04x", *s);
+        } else {
+            putchar(*s);
+        }
+    }
+
+    putchar('"');
+}
+
+static void printTiming(const char* name, Timing* t, bool last) {
+    u64 median = 0;
+    u64 min = 0;
+    if (t->count) {
+        qsort(t->samples, t->count, sizeof(u64), compareSamples);
+        median = t->samples[t->count / 2];
+        min = t->samples[0];
+    }
+
+    printf("      \"%s\": { \"median_ns\": %llu, \"min_ns\": %llu }%s\n", name, (unsigned long long)median, (unsigned long long)min, last ? "" : ",");
+}
+
+#ifdef CTRDL_LOAD_STATS
+static void printLoadStats(const CTRDLLoadStats* stats) {
+    static const char* phases[CTRDL_NUM_PHASES] = { "open", "parse", "deps", "alloc", "read", "reloc", "protect", "cache", "init" };
+    static const char* scopes[CTRDL_NUM_SCOPES] = { "resolver", "program", "global", "self", "deps", "none" };
+
+    printf("      \"load_ticks\": {");
+    for (size_t i = 0; i < CTRDL_NUM_PHASES; ++i)
+        printf(" \"%s\": %llu,", phases[i], (unsigned long long)stats->ticks[i]);
+
+    printf(" \"total\": %llu },\n", (unsigned long long)stats->totalTicks);
+    printf("      \"resolved\": {");
+    for (size_t i = 0; i < CTRDL_NUM_SCOPES; ++i)
+        printf(" \"%s\": %zu%s", scopes[i], stats->numResolved[i], (i == (CTRDL_NUM_SCOPES - 1)) ? " },\n" : ",");
+
+    printf("      \"bytes_read\": %zu,\n", stats->bytesRead);
+    printf("      \"bytes_mapped\": %zu,\n", stats->bytesMapped);
+}
+#endif // CTRDL_LOAD_STATS
+
+static void printObject(Object* obj, const char* error, bool last) {
+    printf("    {\n      \"path\": ");
+    printString(obj->path);
+    printf(",\n");
+
+    if (error) {
+        printf("      \"error\": ");
+        printString(error);
+        printf("\n    }%s\n", last ? "" : ",");
+        return;
+    }
+
+    printf("      \"size\": %zu,\n", obj->size);
+    printf("      \"imports\": %zu,\n", obj->imports.count);
+    printf("      \"exports\": %zu,\n", obj->exports.count);
+    printf("      \"relocs\": %zu,\n", obj->numRelocs);
+#ifdef CTRDL_LOAD_STATS
+    printLoadStats(&obj->loadStats);
+#endif // CTRDL_LOAD_STATS
+    printTiming("parse", &obj->parse, false);
+    printTiming("relocate", &obj->relocate, false);
+    printTiming("dlsym", &obj->dlsym, false);
+    printTiming("dladdr", &obj->dladdr, false);
+    printTiming("open_close", &obj->openClose, true);
+    printf("    }%s\n", last ? "" : ",");
+}
+
+static const char* runObject(Object* obj) {
+    Timing* timings[] = { &obj->parse, &obj->relocate, &obj->openClose, &obj->dlsym, &obj->dladdr };
+    for (size_t i = 0; i < (sizeof(timings) / sizeof(timings[0])); ++i) {
+        timings[i]->samples = calloc(g_Iterations, sizeof(u64));
+        if (!timings[i]->samples)
+            return "out of memory";
+    }
+
+    if (!readFile(obj))
+        return "could not read file";
+
+    if (!prepareObject(obj))
+        return "not a valid object";
+
+    if (!benchParse(obj))
+        return "parse failed";
+
+    if (!benchRelocate(obj))
+        return "relocation failed";
+
+    if (!benchOpenClose(obj))
+        return dlerror();
+
+    if (!benchLookups(obj))
+        return "lookup failed";
+
+    return NULL;
+}
+
+static void freeObject(Object* obj) {
+    if (obj->image)
+        ctrlFreeCodePages(obj->image, obj->numPages);
+
+    free(obj->buffer);
+    free(obj->imports.names);
+    free(obj->exports.names);
+    free(obj->exports.values);
+    free(obj->parse.samples);
+    free(obj->relocate.samples);
+    free(obj->openClose.samples);
+    free(obj->dlsym.samples);
+    free(obj->dladdr.samples);
+}
+
+int main(int argc, char* argv[]) {
+    int first = 1;
+    if ((argc > 2) && !strcmp(argv[1], "-n")) {
+        g_Iterations = strtoul(argv[2], NULL, 10);
+        first = 3;
+    }
+
+    if (!g_Iterations || (first >= argc)) {
+        fprintf(stderr, "Usage: %s [-n iterations] object.so...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool failed = false;
+    printf("{\n  \"iterations\": %zu,\n  \"objects\": [\n", g_Iterations);
+
+    for (int i = first; i < argc; ++i) {
+        Object obj = {};
+        obj.path = argv[i];
+
+        const char* error = runObject(&obj);
+        printObject(&obj, error, i == (argc - 1));
+        failed |= error != NULL;
+        freeObject(&obj);
+    }
+
+    printf("  ]\n}\n");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+#include "Image.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_READERS 4
+#define NUM_WRITERS 2
+#define NUM_LIVE 6          // Objects kept loaded by each writer.
+#define NUM_ITERATIONS 1000 // Loads issued by each writer.
+#define NUM_KNOWN 64        // Addresses of recent objects, probed by readers.
+
+static u32 g_NextId = 0;
+static u32 g_Known[NUM_KNOWN] = {};
+static void* g_Main = NULL;
+static bool g_Stop = false;
+static bool g_Failed = false;
+static size_t g_NumHits = 0;
+static size_t g_NumLeaked = 0;
+
+static void fail(const char* msg, u32 id) {
+    fprintf(stderr, "FAIL: %s (object %u)\n", msg, id);
+    __atomic_store_n(&g_Failed, true, __ATOMIC_RELAXED);
+}
+
+static void* loadObject(Image* image) {
+    const u32 id = __atomic_fetch_add(&g_NextId, 1, __ATOMIC_RELAXED);
+    const bool global = !(id & 1);
+
+    // The buffer is only read while mapping.
+    buildImage(image, id);
+    void* h = ctrdlMap(image, sizeof(Image), RTLD_NOW | (global ? RTLD_GLOBAL : RTLD_LOCAL), NULL, NULL);
+    if (!h) {
+        fail(dlerror(), id);
+        return NULL;
+    }
+
+    CTRDLInfo info;
+    if (!ctrdlInfo(h, &info)) {
+        fail("no info for a loaded object", id);
+        return h;
+    }
+
+    __atomic_store_n(&g_Known[id % NUM_KNOWN], info.base, __ATOMIC_RELAXED);
+    ctrdlFreeInfo(&info);
+    return h;
+}
+
+static void* writerMain(void* arg) {
+    unsigned int seed = (unsigned int)(size_t)arg;
+    void* live[NUM_LIVE] = {};
+    Image* image = malloc(sizeof(Image));
+    if (!image) {
+        fail("out of memory", 0);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < NUM_ITERATIONS; ++i) {
+        const size_t slot = rand_r(&seed) % NUM_LIVE;
+        if (live[slot]) {
+            if (dlclose(live[slot]))
+                fail("could not unload", 0);
+
+            live[slot] = NULL;
+        }
+
+        live[slot] = loadObject(image);
+    }
+
+    for (size_t i = 0; i < NUM_LIVE; ++i) {
+        if (live[i])
+            dlclose(live[i]);
+    }
+
+    free(image);
+    return NULL;
+}
+
+// Objects found by address are locked, they must stay loaded and consistent.
+static void checkObject(void* h, u32 addr) {
+    CTRDLInfo info;
+    if (!ctrdlInfo(h, &info)) {
+        fail("no info for a locked object", 0);
+        return;
+    }
+
+    const u32 base = info.base;
+    const size_t size = info.size;
+    ctrdlFreeInfo(&info);
+
+    if ((addr < base) || (addr >= (base + size))) {
+        fail("address outside of the object", 0);
+        return;
+    }
+
+    const Image* image = (const Image*)(uintptr_t)base;
+    if (image->magic != IMAGE_MAGIC) {
+        fail("locked object was unloaded", 0);
+        return;
+    }
+
+    const u32 id = image->id;
+    char name[16];
+    makeUniqueName(name, sizeof(name), id);
+
+    const u32 offset = addr - base;
+    const char* expected = NULL;
+    if (offset >= (offsetof(Image, data) + 8)) {
+        expected = name;
+    } else if (offset >= offsetof(Image, data)) {
+        expected = "shared";
+    }
+
+    Dl_info dlInfo;
+    if (!dladdr((const void*)(uintptr_t)addr, &dlInfo) || ((u32)(uintptr_t)dlInfo.dli_fbase != base)) {
+        fail("wrong object by address", id);
+    } else if (expected ? (!dlInfo.dli_sname || strcmp(dlInfo.dli_sname, expected)) : (dlInfo.dli_sname != NULL)) {
+        fail("wrong symbol by address", id);
+    }
+
+    if ((u32)(uintptr_t)dlsym(h, name) != (base + offsetof(Image, data) + 8))
+        fail("wrong symbol by name", id);
+
+    if ((u32)(uintptr_t)ctrdlSymConst(h, "shared") != (base + offsetof(Image, data)))
+        fail("wrong symbol by prehashed name", id);
+
+    // Objects loaded as global are found in the global scope as soon as they're published.
+    if (!(id & 1) && ((u32)(uintptr_t)dlsym(g_Main, name) != (base + offsetof(Image, data) + 8)))
+        fail("wrong global symbol", id);
+}
+
+static void* readerMain(void* arg) {
+    unsigned int seed = (unsigned int)(size_t)arg;
+    size_t numHits = 0;
+
+    while (!__atomic_load_n(&g_Stop, __ATOMIC_RELAXED)) {
+        // Known addresses may be stale, or reused by newer objects.
+        const u32 base = __atomic_load_n(&g_Known[rand_r(&seed) % NUM_KNOWN], __ATOMIC_RELAXED);
+        if (base) {
+            const u32 addr = base + (rand_r(&seed) % sizeof(Image));
+            void* h = ctrdlHandleByAddress(addr);
+            if (h) {
+                checkObject(h, addr);
+                if (dlclose(h))
+                    fail("could not release an object found by address", 0);
+
+                ++numHits;
+            }
+        }
+
+        dlsym(g_Main, "shared");
+    }
+
+    __atomic_add_fetch(&g_NumHits, numHits, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void countLeaked(void* handle) {
+    if (handle != g_Main)
+        ++g_NumLeaked;
+}
+
+int main(int argc, char* argv[]) {
+    pthread_t readers[NUM_READERS];
+    pthread_t writers[NUM_WRITERS];
+
+    g_Main = dlopen(NULL, RTLD_NOW);
+
+    for (size_t i = 0; i < NUM_READERS; ++i)
+        pthread_create(&readers[i], NULL, readerMain, (void*)(i + 1));
+
+    for (size_t i = 0; i < NUM_WRITERS; ++i)
+        pthread_create(&writers[i], NULL, writerMain, (void*)(i + 100));
+
+    for (size_t i = 0; i < NUM_WRITERS; ++i)
+        pthread_join(writers[i], NULL);
+
+    __atomic_store_n(&g_Stop, true, __ATOMIC_RELAXED);
+
+    for (size_t i = 0; i < NUM_READERS; ++i)
+        pthread_join(readers[i], NULL);
+
+    ctrdlEnumerate(countLeaked);
+    if (g_NumLeaked)
+        fail("objects were leaked", 0);
+
+    if (!g_NumHits)
+        fail("readers never found an object", 0);
+
+    printf("Mapped %u objects, %zu lookups by address succeeded\n", g_NextId, g_NumHits);
+    return g_Failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
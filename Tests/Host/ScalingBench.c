@@ -0,0 +1,137 @@
+#include "FakeObject.h"
+#include "Symbol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_LOOKUPS 100000 // Lookups timed for each operation.
+#define MIN_MODULES 10
+#define DEFAULT_MAX_MODULES 1000
+
+static u64 nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+static double perOp(u64 begin, size_t count) { return (double)(nowNs() - begin) / (double)count; }
+
+static u32 nextRandom(u32* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Modules depend on a shared core and on their parent, as in a tree of mods.
+static bool runScale(size_t numModules) {
+    CTRDLHandle** handles = calloc(numModules, sizeof(CTRDLHandle*));
+    void** ids = calloc(numModules, sizeof(void*));
+    CTRDLSymKey* keys = calloc(numModules, sizeof(CTRDLSymKey));
+    char (*names)[16] = calloc(numModules, sizeof(*names));
+    if (!handles || !ids || !keys || !names) {
+        fprintf(stderr, "FAIL: out of memory\n");
+        return false;
+    }
+
+    bool success = true;
+    u32 seed = 0x7510;
+
+    for (size_t i = 0; i < numModules; ++i) {
+        makeUniqueName(names[i], sizeof(names[i]), i);
+        ctrdl_makeELFSymKey(&keys[i], names[i]);
+    }
+
+    u64 begin = nowNs();
+    for (size_t i = 0; i < numModules; ++i) {
+        const size_t parent = i ? ((i - 1) / 2) : 0;
+        CTRDLHandle* deps[2] = { handles[0], handles[parent] };
+        const size_t numDeps = !i ? 0 : (parent ? 2 : 1);
+
+        handles[i] = loadFakeObject(i, RTLD_NOW | RTLD_GLOBAL, deps, numDeps);
+        if (!handles[i]) {
+            fprintf(stderr, "FAIL: could not load module %zu\n", i);
+            return false;
+        }
+
+        ids[i] = ctrdl_getHandleId(handles[i]);
+    }
+
+    const double openNs = perOp(begin, numModules);
+
+    begin = nowNs();
+    for (size_t i = 0; i < NUM_LOOKUPS; ++i) {
+        const size_t index = nextRandom(&seed) % numModules;
+        success &= ctrdl_getHandleById(ids[index]) == handles[index];
+    }
+
+    const double idNs = perOp(begin, NUM_LOOKUPS);
+
+    // The core is searched last, after every ancestor of the module.
+    begin = nowNs();
+    for (size_t i = 0; i < NUM_LOOKUPS; ++i) {
+        const size_t index = nextRandom(&seed) % numModules;
+        u32 base = 0;
+        success &= ctrdl_symNameLookupDepOrder(ctrdl_getHandleById(ids[index]), &keys[0], &base) && (base == handles[0]->base);
+    }
+
+    const double symNs = perOp(begin, NUM_LOOKUPS);
+
+    begin = nowNs();
+    for (size_t i = 0; i < NUM_LOOKUPS; ++i) {
+        const size_t index = nextRandom(&seed) % numModules;
+        u32 base = 0;
+        success &= ctrdl_symNameLookupGlobal(&keys[index], &base) && (base == handles[index]->base);
+    }
+
+    const double globalNs = perOp(begin, NUM_LOOKUPS);
+
+    begin = nowNs();
+    for (size_t i = 0; i < NUM_LOOKUPS; ++i) {
+        const size_t index = nextRandom(&seed) % numModules;
+        CTRDLHandle* h = ctrdl_lockHandleByAddr(handles[index]->base + sizeof(Image) - 1);
+        success &= (h == handles[index]) && ctrdl_symValueLookupSingle(h, sizeof(Image) - 1);
+        if (h)
+            ctrdl_unlockHandle(h);
+    }
+
+    const double addrNs = perOp(begin, NUM_LOOKUPS);
+
+    // Dependents go first, so that every close unloads an object.
+    begin = nowNs();
+    for (size_t i = numModules; i-- > 0;)
+        success &= ctrdl_unlockHandle(handles[i]);
+
+    const double closeNs = perOp(begin, numModules);
+
+    // Ids of closed objects are rejected.
+    for (size_t i = 0; i < numModules; ++i)
+        success &= !ctrdl_getHandleById(ids[i]);
+
+    ctrdl_acquireHandleMtx();
+    success &= !ctrdl_unsafeNumHandles();
+    ctrdl_releaseHandleMtx();
+
+    printf("%8zu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", numModules, openNs, idNs, symNs, globalNs, addrNs, closeNs);
+
+    if (!success)
+        fprintf(stderr, "FAIL: wrong results with %zu modules\n", numModules);
+
+    free(names);
+    free(keys);
+    free(ids);
+    free(handles);
+    return success;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t maxModules = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_MAX_MODULES;
+    bool success = true;
+
+    printf("%8s %10s %10s %10s %10s %10s %10s\n", "modules", "open", "id", "dlsym", "global", "dladdr", "close");
+    printf("%8s %10s %10s %10s %10s %10s %10s\n", "", "(ns/op)", "(ns/op)", "(ns/op)", "(ns/op)", "(ns/op)", "(ns/op)");
+
+    for (size_t numModules = MIN_MODULES; numModules <= maxModules; numModules *= 10)
+        success &= runScale(numModules);
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
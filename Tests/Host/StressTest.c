@@ -0,0 +1,206 @@
+#include "FakeObject.h"
+#include "Symbol.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_READERS 4
+#define NUM_WRITERS 2
+#define NUM_LIVE 6          // Objects kept loaded by each writer.
+#define NUM_ITERATIONS 2000 // Loads issued by each writer.
+#define NUM_KNOWN 64        // Addresses of recent objects, probed by readers.
+
+static u32 g_NextId = 0;
+static u32 g_Known[NUM_KNOWN] = {};
+static bool g_Stop = false;
+static bool g_Failed = false;
+static size_t g_NumHits = 0;
+
+static void fail(const char* msg, u32 id) {
+    fprintf(stderr, "FAIL: %s (object %u)\n", msg, id);
+    __atomic_store_n(&g_Failed, true, __ATOMIC_RELAXED);
+}
+
+static CTRDLHandle* loadObject(CTRDLHandle* dep) {
+    const u32 id = __atomic_fetch_add(&g_NextId, 1, __ATOMIC_RELAXED);
+    const bool global = !(id & 1);
+
+    CTRDLHandle* h = loadFakeObject(id, RTLD_NOW | (global ? RTLD_GLOBAL : RTLD_LOCAL), &dep, dep ? 1 : 0);
+    if (!h)
+        return NULL;
+
+    // Local objects are promoted afterwards.
+    if (!global) {
+        CTRDLHandle* again = ctrdl_reopenHandle(h->path, h->pathHash, RTLD_NOW | RTLD_GLOBAL, NULL, NULL);
+        if (again != h)
+            fail("reopen returned another object", id);
+
+        ctrdl_unlockHandle(again);
+    }
+
+    __atomic_store_n(&g_Known[id % NUM_KNOWN], h->base, __ATOMIC_RELAXED);
+    return h;
+}
+
+static void* writerMain(void* arg) {
+    unsigned int seed = (unsigned int)(size_t)arg;
+    CTRDLHandle* live[NUM_LIVE] = {};
+
+    for (size_t i = 0; i < NUM_ITERATIONS; ++i) {
+        const size_t slot = rand_r(&seed) % NUM_LIVE;
+        if (live[slot]) {
+            if (!ctrdl_unlockHandle(live[slot]))
+                fail("could not unload", 0);
+
+            live[slot] = NULL;
+        }
+
+        // Keep dependency chains short.
+        CTRDLHandle* dep = live[(slot + 1) % NUM_LIVE];
+        if (dep && dep->numDeps)
+            dep = NULL;
+
+        live[slot] = loadObject(dep);
+    }
+
+    for (size_t i = 0; i < NUM_LIVE; ++i) {
+        if (live[i])
+            ctrdl_unlockHandle(live[i]);
+    }
+
+    return NULL;
+}
+
+// Locked objects must stay loaded and consistent.
+static void checkObject(CTRDLHandle* h, u32 addr) {
+    const Image* image = (const Image*)(uintptr_t)h->base;
+    if ((addr < h->base) || (addr >= (h->base + h->size))) {
+        fail("address outside of the object", 0);
+        return;
+    }
+
+    if (image->magic != IMAGE_MAGIC) {
+        fail("locked object was unloaded", 0);
+        return;
+    }
+
+    const u32 offset = addr - h->base;
+    const Elf32_Sym* expected = NULL;
+    if (offset >= (offsetof(Image, data) + 8)) {
+        expected = &image->syms[2];
+    } else if (offset >= offsetof(Image, data)) {
+        expected = &image->syms[1];
+    }
+
+    if (ctrdl_getHandleById(ctrdl_getHandleId(h)) != h)
+        fail("id doesn't resolve to the object", image->id);
+
+    if (ctrdl_symValueLookupSingle(h, offset) != expected)
+        fail("wrong symbol by address", image->id);
+
+    char name[16];
+    makeUniqueName(name, sizeof(name), image->id);
+
+    CTRDLSymKey key;
+    ctrdl_makeELFSymKey(&key, name);
+    u32 base = 0;
+    if ((ctrdl_symNameLookupDepOrder(h, &key, &base) != &image->syms[2]) || (base != h->base))
+        fail("wrong symbol by name", image->id);
+
+    CTRDLSymKey sharedKey;
+    ctrdl_makeELFSymKeyHashed(&sharedKey, "shared", sizeof("shared") - 1, CTRDL_GNU_HASH("shared"), CTRDL_ELF_HASH_NONE);
+    if (ctrdl_symNameLookupDepOrder(h, &sharedKey, &base) != &image->syms[1])
+        fail("wrong symbol by prehashed name", image->id);
+
+    // Dependencies are kept loaded by the object, and searched after it.
+    CTRDLHandle* dep = h->numDeps ? h->deps[0] : NULL;
+    if (dep) {
+        const Image* depImage = (const Image*)(uintptr_t)dep->base;
+        char depName[16];
+        makeUniqueName(depName, sizeof(depName), depImage->id);
+
+        CTRDLSymKey depKey;
+        ctrdl_makeELFSymKey(&depKey, depName);
+        if ((ctrdl_symNameLookupDepOrder(h, &depKey, &base) != &depImage->syms[2]) || (base != dep->base))
+            fail("wrong symbol from dependency", image->id);
+    }
+
+    // Batches report missing symbols without affecting the others.
+    CTRDLSymBatchEntry entries[3] = {};
+    entries[0].key = key;
+    entries[1].key = sharedKey;
+    ctrdl_makeELFSymKey(&entries[2].key, "missing");
+    if ((ctrdl_symNameLookupDepOrderBatch(h, entries, 3) != 1) || (entries[0].sym != &image->syms[2]) || (entries[1].sym != &image->syms[1]) || entries[2].sym)
+        fail("wrong symbols by batch", image->id);
+
+    // Objects loaded as global are found in the global scope as soon as they're published.
+    if (!(image->id & 1) && ((ctrdl_symNameLookupGlobal(&key, &base) != &image->syms[2]) || (base != h->base)))
+        fail("wrong global symbol", image->id);
+}
+
+static void* readerMain(void* arg) {
+    unsigned int seed = (unsigned int)(size_t)arg;
+    size_t numHits = 0;
+
+    CTRDLSymKey sharedKey;
+    ctrdl_makeELFSymKey(&sharedKey, "shared");
+
+    while (!__atomic_load_n(&g_Stop, __ATOMIC_RELAXED)) {
+        // Known addresses may be stale, or reused by newer objects.
+        const u32 base = __atomic_load_n(&g_Known[rand_r(&seed) % NUM_KNOWN], __ATOMIC_RELAXED);
+        if (base) {
+            const u32 addr = base + (rand_r(&seed) % sizeof(Image));
+            CTRDLHandle* h = ctrdl_lockHandleByAddr(addr);
+            if (h) {
+                checkObject(h, addr);
+                ctrdl_unlockHandle(h);
+                ++numHits;
+            }
+        }
+
+        u32 modBase;
+        ctrdl_symNameLookupGlobal(&sharedKey, &modBase);
+    }
+
+    __atomic_add_fetch(&g_NumHits, numHits, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    pthread_t readers[NUM_READERS];
+    pthread_t writers[NUM_WRITERS];
+
+    // The mutex is lazily initialized, do it before other threads are started.
+    ctrdl_acquireHandleMtx();
+    ctrdl_releaseHandleMtx();
+
+    for (size_t i = 0; i < NUM_READERS; ++i)
+        pthread_create(&readers[i], NULL, readerMain, (void*)(i + 1));
+
+    for (size_t i = 0; i < NUM_WRITERS; ++i)
+        pthread_create(&writers[i], NULL, writerMain, (void*)(i + 100));
+
+    for (size_t i = 0; i < NUM_WRITERS; ++i)
+        pthread_join(writers[i], NULL);
+
+    __atomic_store_n(&g_Stop, true, __ATOMIC_RELAXED);
+
+    for (size_t i = 0; i < NUM_READERS; ++i)
+        pthread_join(readers[i], NULL);
+
+    ctrdl_acquireHandleMtx();
+    const size_t numHandles = ctrdl_unsafeNumHandles();
+    const CTRDLHandle* first = ctrdl_unsafeNextHandle(NULL);
+    ctrdl_releaseHandleMtx();
+
+    if (numHandles || first)
+        fail("objects were leaked", 0);
+
+    if (!g_NumHits)
+        fail("readers never found an object", 0);
+
+    printf("Loaded %u objects, %zu lookups by address succeeded\n", g_NextId, g_NumHits);
+    return g_Failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}